@@ -0,0 +1,435 @@
+/*
+
+BCM benchmark - times Compress(), Decompress() and libsais_bwt() on a
+generated corpus, and checks the results against a stored baseline
+
+  gcc -O2 -c src/libsais.c src/libsais64.c
+  g++ -O2 -o bcm-bench bench/bench.cpp libsais.o libsais64.o -pthread
+  ./bcm-bench [options]
+
+Every case runs in its own process, so its peak RSS is its own. Speed is
+the median of the runs, in MB/s of original data. A case regresses when
+it's slower or bigger in memory than the baseline by more than the
+tolerance, or when its compressed size grows at all. The baseline is
+machine specific - record it with -u on the box that checks the builds
+
+*/
+
+#define main bcm_main
+#include "../src/bcm.cpp"
+#undef main
+
+#include <algorithm>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+const char* base="bench/baseline.json"; // -b
+int runs=5; // -r
+double tol=10; // -p, percent
+int update=0; // -u
+
+char dir[]="/tmp/bcm-bench-XXXXXX";
+
+struct Result
+{
+  char name[64];
+  double mbps;
+  S64 size;
+  S64 rss; // KB
+};
+
+// The corpus is made up here, the same on every box
+
+U32 seed;
+
+U32 Rand() // Xorshift
+{
+  seed^=seed<<13;
+  seed^=seed>>17;
+  seed^=seed<<5;
+  return seed;
+}
+
+void MakeText(std::vector<U8>& v, size_t n)
+{
+  seed=1;
+  std::vector<std::string> words;
+  for (int i=0; i<4096; ++i)
+  {
+    std::string w;
+    const int len=2+Rand()%4+Rand()%5;
+    for (int j=0; j<len; ++j)
+      w+=char("etaoinshrdlucmfwypvbgkjqxz"[Rand()%(4+j*3<26?4+j*3:26)]);
+    words.push_back(w);
+  }
+
+  int col=0;
+  while (v.size()<n)
+  {
+    const std::string& w=words[Rand()%(1+Rand()%4096)]; // Zipf-like
+    v.insert(v.end(), w.begin(), w.end());
+    col+=int(w.size())+1;
+    if (col>72)
+    {
+      v.push_back('\n');
+      col=0;
+    }
+    else
+      v.push_back(Rand()%11?' ':',');
+  }
+  v.resize(n);
+}
+
+void MakeRecords(std::vector<U8>& v, size_t n)
+{
+  seed=2;
+  U32 id=1000;
+  U32 t=1600000000;
+  while (v.size()<n)
+  {
+    id+=1+Rand()%3;
+    t+=Rand()%60;
+    const U32 f[4]={id, t, Rand()%100, 50000+Rand()%1000};
+    for (int i=0; i<4; ++i)
+    {
+      for (int j=0; j<4; ++j)
+        v.push_back(U8(f[i]>>(j*8)));
+    }
+  }
+  v.resize(n);
+}
+
+void MakeRandom(std::vector<U8>& v, size_t n)
+{
+  seed=3;
+  while (v.size()<n)
+    v.push_back(U8(Rand()));
+}
+
+double Now()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double Median(std::vector<double>& t)
+{
+  std::sort(t.begin(), t.end());
+  return t[t.size()/2];
+}
+
+FILE* Open(const std::string& name, const char* mode)
+{
+  FILE* f=fopen(name.c_str(), mode);
+  if (!f)
+  {
+    perror(name.c_str());
+    exit(1);
+  }
+  return f;
+}
+
+int Same(const std::string& a, const std::string& b)
+{
+  FILE* f=Open(a, "rb");
+  FILE* g=Open(b, "rb");
+  int c;
+  while ((c=getc(f))==getc(g) && c!=EOF)
+    ;
+  fclose(f);
+  fclose(g);
+  return c==EOF;
+}
+
+// Child side - time the case, send back the median and the size
+
+void Run(const std::string& corpus, char op, int lvl, int fd)
+{
+  const std::string src=std::string(dir)+"/"+corpus;
+  const std::string bcm=src+"."+char('0'+lvl)+".bcm";
+  const std::string dst=src+".out";
+
+  std::vector<double> t;
+  S64 size=0;
+  for (int r=0; r<runs; ++r)
+  {
+    if (op=='c')
+    {
+      level=lvl;
+      FILE* in=Open(src, "rb");
+      FILE* out=Open(bcm, "wb");
+      const double s=Now();
+      Compress(in, out);
+      fflush(out);
+      t.push_back(Now()-s);
+      size=_ftelli64(out);
+      fclose(in);
+      fclose(out);
+    }
+    else if (op=='d')
+    {
+      FILE* in=Open(bcm, "rb");
+      FILE* out=Open(dst, "wb");
+      const double s=Now();
+      Header h;
+      if (!ReadHeader(in, h))
+      {
+        fprintf(stderr, "%s: Not in BCM format\n", bcm.c_str());
+        exit(1);
+      }
+      Decompress(in, out, h);
+      fflush(out);
+      t.push_back(Now()-s);
+      size=_ftelli64(out);
+      fclose(in);
+      fclose(out);
+      if (!Same(src, dst))
+      {
+        fprintf(stderr, "%s: Decoded data differs\n", bcm.c_str());
+        exit(1);
+      }
+    }
+    else // BWT alone
+    {
+      FILE* in=Open(src, "rb");
+      _fseeki64(in, 0, SEEK_END);
+      const int n=int(_ftelli64(in));
+      rewind(in);
+      U8* buf=MemAlloc<U8>(n);
+      U8* bwt=MemAlloc<U8>(n);
+      int* sa=MemAlloc<int>(n);
+      if (fread(buf, 1, n, in)!=size_t(n))
+      {
+        perror(src.c_str());
+        exit(1);
+      }
+      fclose(in);
+      const double s=Now();
+      size=libsais_bwt(buf, bwt, sa, n);
+      t.push_back(Now()-s);
+      MemFree(sa, n);
+      MemFree(bwt, n);
+      MemFree(buf, n);
+    }
+  }
+
+  const double m=Median(t);
+  if (write(fd, &m, sizeof(m))!=sizeof(m) || write(fd, &size, sizeof(size))!=sizeof(size))
+    exit(1);
+}
+
+Result Case(const std::string& corpus, S64 n, char op, int lvl)
+{
+  Result r;
+  if (op=='b')
+    snprintf(r.name, sizeof(r.name), "%s/bwt", corpus.c_str());
+  else
+    snprintf(r.name, sizeof(r.name), "%s/%c%d", corpus.c_str(), op, lvl);
+
+  int fd[2];
+  if (pipe(fd))
+  {
+    perror("Pipe() failed");
+    exit(1);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  const pid_t pid=fork();
+  if (pid<0)
+  {
+    perror("Fork() failed");
+    exit(1);
+  }
+  if (pid==0)
+  {
+    close(fd[0]);
+    Run(corpus, op, lvl, fd[1]);
+    _exit(0);
+  }
+  close(fd[1]);
+
+  double m=0;
+  const int ok=read(fd[0], &m, sizeof(m))==sizeof(m)
+      && read(fd[0], &r.size, sizeof(r.size))==sizeof(r.size);
+  close(fd[0]);
+
+  int status;
+  struct rusage ru;
+  if (wait4(pid, &status, 0, &ru)<0 || !ok || !WIFEXITED(status)
+      || WEXITSTATUS(status)!=0)
+  {
+    fprintf(stderr, "%s: Case failed\n", r.name);
+    exit(1);
+  }
+
+  if (op=='b') // The index, not a size
+    r.size=0;
+  r.mbps=(m>0)?n/m/1e6:0;
+  r.rss=ru.ru_maxrss;
+  return r;
+}
+
+// One case per line, so the baseline reads back with sscanf()
+
+void Save(const std::vector<Result>& res, FILE* f)
+{
+  fprintf(f, "{\n  \"cases\": [\n");
+  for (size_t i=0; i<res.size(); ++i)
+  {
+    fprintf(f, "    {\"name\": \"%s\", \"mbps\": %.2f, \"size\": %lld, \"rss_kb\": %lld}%s\n",
+        res[i].name, res[i].mbps, res[i].size, res[i].rss, i+1<res.size()?",":"");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+int Load(const char* name, std::vector<Result>& res)
+{
+  FILE* f=fopen(name, "r");
+  if (!f)
+    return 0;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f))
+  {
+    Result r;
+    if (sscanf(line, " {\"name\": \"%63[^\"]\", \"mbps\": %lf, \"size\": %lld, \"rss_kb\": %lld",
+        r.name, &r.mbps, &r.size, &r.rss)==4)
+      res.push_back(r);
+  }
+  fclose(f);
+  return 1;
+}
+
+int Compare(const std::vector<Result>& res, const std::vector<Result>& old)
+{
+  int bad=0;
+  for (size_t i=0; i<res.size(); ++i)
+  {
+    const Result& r=res[i];
+    const Result* b=nullptr;
+    for (size_t j=0; j<old.size() && !b; ++j)
+    {
+      if (!strcmp(old[j].name, r.name))
+        b=&old[j];
+    }
+    if (!b)
+    {
+      fprintf(stderr, "%-12s not in the baseline\n", r.name);
+      continue;
+    }
+
+    const char* why=nullptr;
+    if (r.mbps<b->mbps*(1-tol/100))
+      why="slower";
+    else if (r.size>b->size)
+      why="bigger output";
+    else if (r.rss>b->rss*(1+tol/100))
+      why="more memory";
+
+    fprintf(stderr, "%-12s %8.2f MB/s (%+5.1f%%) %10lld (%+lld) %8lld KB (%+5.1f%%)%s%s\n",
+        r.name, r.mbps, b->mbps>0?(r.mbps/b->mbps-1)*100:0, r.size, r.size-b->size,
+        r.rss, b->rss>0?(double(r.rss)/b->rss-1)*100:0, why?" - REGRESSION: ":"", why?why:"");
+    bad+=(why!=nullptr);
+  }
+  return bad;
+}
+
+int main(int argc, char** argv)
+{
+  for (int i=1; i<argc; ++i)
+  {
+    if (!strcmp(argv[i], "-u"))
+      update=1;
+    else if (!strcmp(argv[i], "-b") && i+1<argc)
+      base=argv[++i];
+    else if (!strcmp(argv[i], "-r") && i+1<argc && (runs=atoi(argv[++i]))>0)
+      continue;
+    else if (!strcmp(argv[i], "-p") && i+1<argc && (tol=atof(argv[++i]))>0)
+      continue;
+    else
+    {
+      fprintf(stderr,
+          "Usage: %s [options]\n"
+          "\n"
+          "  -b file  Baseline (default: %s)\n"
+          "  -r N     Runs per case, the median counts (default: %d)\n"
+          "  -p N     Tolerance for speed and memory, percent (default: %g)\n"
+          "  -u       Write the results as the new baseline\n"
+          "\n"
+          "Results are printed to stdout as JSON. Exits with 1 on regression\n",
+          argv[0], base, runs, tol);
+      exit(1);
+    }
+  }
+
+  CRC::Init();
+  pool.Start(1); // One thread, for stable numbers
+
+  if (!mkdtemp(dir))
+  {
+    perror(dir);
+    exit(1);
+  }
+
+  struct Corpus
+  {
+    const char* name;
+    void (*make)(std::vector<U8>&, size_t);
+    size_t n;
+  } corpus[]=
+  {
+    {"text", MakeText, 8<<20},
+    {"records", MakeRecords, 8<<20},
+    {"random", MakeRandom, 2<<20},
+  };
+
+  std::vector<Result> res;
+  for (size_t i=0; i<sizeof(corpus)/sizeof(corpus[0]); ++i)
+  {
+    const Corpus& c=corpus[i];
+    std::vector<U8> v;
+    c.make(v, c.n);
+    FILE* f=Open(std::string(dir)+"/"+c.name, "wb");
+    fwrite(&v[0], 1, v.size(), f);
+    fclose(f);
+
+    res.push_back(Case(c.name, c.n, 'b', 0));
+    const int lvl[]={1, 4};
+    for (int j=0; j<2; ++j)
+    {
+      res.push_back(Case(c.name, c.n, 'c', lvl[j]));
+      res.push_back(Case(c.name, c.n, 'd', lvl[j]));
+    }
+
+    for (int j=0; j<2; ++j)
+      remove((std::string(dir)+"/"+c.name+"."+char('0'+lvl[j])+".bcm").c_str());
+    remove((std::string(dir)+"/"+c.name+".out").c_str());
+    remove((std::string(dir)+"/"+c.name).c_str());
+  }
+  rmdir(dir);
+
+  Save(res, stdout);
+
+  if (update)
+  {
+    FILE* f=Open(base, "w");
+    Save(res, f);
+    fclose(f);
+    fprintf(stderr, "Baseline written to '%s'\n", base);
+    return 0;
+  }
+
+  std::vector<Result> old;
+  if (!Load(base, old))
+  {
+    fprintf(stderr, "No baseline '%s', run with -u to make one\n", base);
+    return 0;
+  }
+
+  const int bad=Compare(res, old);
+  if (bad)
+    fprintf(stderr, "%d regression(s)\n", bad);
+  return bad?1:0;
+}
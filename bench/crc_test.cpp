@@ -0,0 +1,105 @@
+/*
+
+CRC32 kernel check - every kernel CRC::Init() can pick must give the same
+result as the byte at a time table, over the same buffers, lengths and
+alignments, in one call or split across calls
+
+  gcc -O2 -c src/libsais.c src/libsais64.c
+  g++ -O2 -o crc-test bench/crc_test.cpp libsais.o libsais64.o -pthread
+  ./crc-test
+
+Exits with 1 on the first mismatch. A kernel the CPU lacks is skipped and
+says so
+
+*/
+
+#define main bcm_main
+#include "../src/bcm.cpp"
+#undef main
+
+struct Kernel
+{
+  const char* name;
+  U32 (*fold)(U32 crc, const U8* buf, size_t n);
+};
+
+U32 seed=1;
+
+U32 Rand() // Xorshift
+{
+  seed^=seed<<13;
+  seed^=seed>>17;
+  seed^=seed<<5;
+  return seed;
+}
+
+U32 Bytes(U32 crc, const U8* buf, size_t n) // The reference
+{
+  for (size_t i=0; i<n; ++i)
+    crc=(crc>>8)^CRC::tab[0][(crc^buf[i])&255];
+  return crc;
+}
+
+int main()
+{
+  CRC::Init();
+
+  std::vector<Kernel> kernel;
+  kernel.push_back({"slice8", CRC::Slice8});
+#ifdef HAVE_CLMUL
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    kernel.push_back({"clmul", CRC::Clmul});
+  else
+    printf("clmul: skipped, not supported by this CPU\n");
+#else
+  printf("clmul: skipped, not built for this target\n");
+#endif
+
+  const size_t most=(1<<20)+64;
+  std::vector<U8> buf(most+16);
+  for (size_t i=0; i<buf.size(); ++i)
+    buf[i]=U8(Rand());
+
+  std::vector<size_t> len;
+  for (size_t n=0; n<=520; ++n) // Every tail past each step of the folds
+    len.push_back(n);
+  const size_t big[]={1000, 4095, 4096, 4097, 65536+15, 1<<20, most};
+  for (size_t i=0; i<sizeof(big)/sizeof(big[0]); ++i)
+    len.push_back(big[i]);
+
+  const U32 init[]={U32(-1), 0, 0x12345678};
+
+  int checks=0;
+  for (size_t k=0; k<kernel.size(); ++k)
+  {
+    const Kernel& kn=kernel[k];
+    for (size_t i=0; i<len.size(); ++i)
+    {
+      const size_t n=len[i];
+      for (int a=0; a<16; ++a) // Alignment
+      {
+        const U8* p=&buf[a];
+        for (int c=0; c<3; ++c)
+        {
+          const U32 want=Bytes(init[c], p, n);
+
+          U32 got=kn.fold(init[c], p, n);
+          const size_t cut=n?Rand()%(n+1):0;
+          const U32 split=kn.fold(kn.fold(init[c], p, cut), p+cut, n-cut);
+
+          if (got!=want || split!=want)
+          {
+            printf("%s: mismatch, length %d, offset %d, seed %08X: %08X %08X, not %08X\n",
+                kn.name, int(n), a, init[c], got, split, want);
+            return 1;
+          }
+          ++checks;
+        }
+      }
+    }
+    printf("%s: ok\n", kn.name);
+  }
+
+  printf("%d checks passed\n", checks);
+  return 0;
+}
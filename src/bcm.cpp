@@ -30,12 +30,30 @@ Copyright (C) 2008-2021 Ilya Muravyov
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <errno.h>
+#include <math.h>
 
-#ifndef NO_UTIME
-#  include <sys/types.h>
-#  include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#  include <io.h>
+#else
+#  include <dirent.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
 
+#ifndef NO_UTIME
 #  ifdef _MSC_VER
 #    include <sys/utime.h>
 #  else
@@ -43,7 +61,49 @@ Copyright (C) 2008-2021 Ilya Muravyov
 #  endif
 #endif
 
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#endif
+
+#if defined(__linux__) && !defined(NO_HUGEPAGES)
+#  define HAVE_HUGEPAGES
+#endif
+
+#if defined(__linux__) && !defined(NO_IO_URING)
+#  define HAVE_IO_URING
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <linux/io_uring.h>
+#endif
+
+#if defined(__linux__) && !defined(NO_FALLOCATE)
+#  define HAVE_FALLOCATE
+#endif
+
+#if !defined(_MSC_VER) && !defined(NO_DAEMON)
+#  define HAVE_DAEMON // --daemon, --via
+#  include <signal.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <sys/wait.h>
+#endif
+
+#if defined(__linux__) && !defined(NO_NUMA)
+#  define HAVE_NUMA
+#  include <sched.h>
+#  include <sys/syscall.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+    && !defined(NO_SIMD)
+#  define HAVE_CLMUL // Picked at run time, see CRC::Init()
+#  include <immintrin.h>
+#endif
+
 #include "libsais.h"
+#include "libsais64.h"
 
 typedef unsigned char U8;
 typedef unsigned short U16;
@@ -53,29 +113,94 @@ typedef signed long long S64;
 
 // Globals
 
-const char magic[]="BCM!";
+const char magic[]="BCM3"; // "BCM!" - v1.60
 
-FILE* in;
-FILE* out;
+int level=4;
+S64 bsize=0; // -b, overrides the level
+int adaptive=0;
+int decompress=0;
+int overwrite=0;
+int test=0;
+int list=0;
+int estimate=0; // -E
+int train=0;
+const char* dname=nullptr; // -D
+const char* rname=nullptr; // --ref
+int dedup=0; // --dedup
+int threads=0;
+int batch=0;
+int streams=1; // -s, parts per block
+enum // What codes the BWT output
+{
+  CODER_CM, // Model<Balanced>
+  CODER_FAST, // See Fast
+  CODER_QUICK, // Model<Quick>
+  CODER_STEADY, // Model<Steady>
+  CODERS
+};
+int coder=CODER_CM; // --fast
+int trial=0; // -x
+double rate=0; // --target-rate, MB/s
+const char* cpus=nullptr; // --cpus
+int numa=0; // --numa
+int part=0; // --part k/N, k
+int nparts=0; // and N
+const char* sname=nullptr; // --daemon, socket to listen on
+const char* via=nullptr; // --via, socket of the daemon
+int jobs=1; // --jobs, daemon workers
+int queue=64; // --queue, connections waiting
+int fmindex=0; // --index
+const char* pattern=nullptr; // --grep, --count
+int count=0; // --count
 
 struct Encoder
 {
+  FILE* in;
+  FILE* out;
+  std::vector<U8>* mem; // Coding to memory instead of out
+  const U8* src; // Decoding from memory instead of in
+  const U8* end;
   U32 low;
   U32 high;
   U32 code;
 
-  Encoder()
+  Encoder(FILE* f_in, FILE* f_out)
+  {
+    Start(f_in, f_out);
+  }
+
+  void Start(FILE* f_in, FILE* f_out)
   {
+    in=f_in;
+    out=f_out;
+    mem=nullptr;
+    src=nullptr;
+    end=nullptr;
     low=0;
     high=U32(-1);
     code=0;
   }
 
+  void Out(int c)
+  {
+    if (mem)
+      mem->push_back(U8(c));
+    else
+      putc(c, out);
+  }
+
+  int In()
+  {
+    if (src)
+      return src<end?*src++:0;
+    return getc(in);
+  }
+
   void Flush()
   {
     for (int i=0; i<4; ++i)
     {
-      putc(low>>24, out);
+      Out(low>>24);
       low<<=8;
     }
   }
@@ -83,7 +208,7 @@ struct Encoder
   void Init()
   {
     for (int i=0; i<4; ++i)
-      code=(code<<8)+getc(in);
+      code=(code<<8)+In();
   }
 
   template<int P_LOG>
@@ -99,7 +224,7 @@ struct Encoder
     // Renormalize
     while ((low^high)<(1<<24))
     {
-      putc(low>>24, out);
+      Out(low>>24);
       low<<=8;
       high=(high<<8)+255;
     }
@@ -121,7 +246,7 @@ struct Encoder
     {
       low<<=8;
       high=(high<<8)+255;
-      code=(code<<8)+getc(in);
+      code=(code<<8)+In();
     }
 
     return bit;
@@ -149,16 +274,38 @@ struct Counter
   }
 };
 
-struct CM: Encoder
+// Model policies - rates of the order-0, order-1 and SSE counters, weights
+// of the mix (of 16) and of SSE (of 4), and the run of equal bytes that
+// switches the SSE set. Each policy is compiled into a model of its own, all
+// with the same counters, so a dictionary primes any of them
+
+struct Balanced
+{
+  enum { R0=2, R1=4, R2=6, W0=7, W1=7, W2=2, SSE=3, RUN=2 };
+};
+
+struct Quick // Small or shifting data
+{
+  enum { R0=1, R1=3, R2=5, W0=6, W1=8, W2=2, SSE=3, RUN=2 };
+};
+
+struct Steady // Data with strong order-1 contexts
+{
+  enum { R0=2, R1=4, R2=6, W0=6, W1=9, W2=1, SSE=3, RUN=2 };
+};
+
+template<typename P>
+struct Model: Encoder
 {
-  Counter<2> counter0[256];
-  Counter<4> counter1[256][256];
-  Counter<6> counter2[2][256][17];
+  Counter<P::R0> counter0[256];
+  Counter<P::R1> counter1[256][256];
+  Counter<P::R2> counter2[2][256][17];
+  U8 stale[256]; // counter1 rows still to be reset, see Reset()
   int run;
   int c1;
   int c2;
 
-  CM()
+  Model(FILE* f_in, FILE* f_out): Encoder(f_in, f_out)
   {
     run=0;
     c1=0;
@@ -172,6 +319,49 @@ struct CM: Encoder
           counter2[i][j][k].p=(k<<12)-(k==16);
       }
     }
+
+    memset(stale, 0, sizeof(stale));
+  }
+
+  // Back to the initial state, for another small input. counter1 is most
+  // of the model and a small input sees a few of its rows, so each row is
+  // reset only when its context first comes up
+
+  void Reset()
+  {
+    run=0;
+    c1=0;
+    c2=0;
+
+    for (int i=0; i<256; ++i)
+      counter0[i].p=1<<15;
+
+    // Every SSE row is the same ramp - copied, not worked out each time
+    Counter<P::R2>* row=counter2[0][0];
+    for (int k=0; k<=16; ++k)
+      row[k].p=(k<<12)-(k==16);
+    for (int i=1; i<2*256; ++i)
+      memcpy(row+i*17, row, sizeof(counter2[0][0]));
+
+    memset(stale, 1, sizeof(stale));
+    Fresh(0);
+  }
+
+  void Fresh(int c)
+  {
+    for (int i=0; i<256; ++i)
+      counter1[c][i].p=1<<15;
+    stale[c]=0;
+  }
+
+  void Prime(const U8* snap)
+  {
+    memset(stale, 0, sizeof(stale));
+    memcpy(counter0, snap, sizeof(counter0));
+    snap+=sizeof(counter0);
+    memcpy(counter1, snap, sizeof(counter1));
+    snap+=sizeof(counter1);
+    memcpy(counter2, snap, sizeof(counter2));
   }
 
   void Put32(U32 x)
@@ -189,9 +379,12 @@ struct CM: Encoder
     return x;
   }
 
-  void Put(int c)
+  // One byte, coded or decoded, the same model both ways
+
+  template<int DECODE>
+  int Code(int c)
   {
-    const int f=(run>2);
+    const int f=(run>P::RUN);
 
     int ctx=1;
     for (int i=128; i>0; i>>=1)
@@ -199,18 +392,23 @@ struct CM: Encoder
       const int p0=counter0[ctx].p;
       const int p1=counter1[c1][ctx].p;
       const int p2=counter1[c2][ctx].p;
-      const int p=(((p0+p1)*7)+p2+p2)>>4;
+      const int p=(p0*P::W0+p1*P::W1+p2*P::W2)>>4;
 
       // SSE with linear interpolation
       const int j=p>>12;
       const int x1=counter2[f][ctx][j].p;
       const int x2=counter2[f][ctx][j+1].p;
       const int ssep=x1+(((x2-x1)*(p&4095))>>12);
+      const U32 q=p*(4-P::SSE)+ssep*P::SSE;
 
-      if (c&i)
-      {
-        EncodeBit<18>(1, p+ssep+ssep+ssep);
+      int bit;
+      if (DECODE)
+        bit=DecodeBit<18>(q);
+      else
+        EncodeBit<18>(bit=((c&i)!=0), q);
 
+      if (bit)
+      {
         counter0[ctx].Update1();
         counter1[c1][ctx].Update1();
         counter2[f][ctx][j].Update1();
@@ -220,8 +418,6 @@ struct CM: Encoder
       }
       else
       {
-        EncodeBit<18>(0, p+ssep+ssep+ssep);
-
         counter0[ctx].Update0();
         counter1[c1][ctx].Update0();
         counter2[f][ctx][j].Update0();
@@ -233,78 +429,90 @@ struct CM: Encoder
 
     c2=c1;
     c1=ctx-256;
+    if (stale[c1])
+      Fresh(c1);
 
     if (c1==c2)
       ++run;
     else
       run=0;
+
+    return c1;
   }
 
-  int Get()
+  void Put(int c)
   {
-    const int f=(run>2);
+    Code<0>(c);
+  }
 
-    int ctx=1;
-    while (ctx<256)
-    {
-      const int p0=counter0[ctx].p;
-      const int p1=counter1[c1][ctx].p;
-      const int p2=counter1[c2][ctx].p;
-      const int p=(((p0+p1)*7)+p2+p2)>>4;
+  int Get()
+  {
+    return Code<1>(0);
+  }
+};
 
-      // SSE with linear interpolation
-      const int j=p>>12;
-      const int x1=counter2[f][ctx][j].p;
-      const int x2=counter2[f][ctx][j+1].p;
-      const int ssep=x1+(((x2-x1)*(p&4095))>>12);
+typedef Model<Balanced> CM; // Of every stream but blocks that say otherwise
 
-      if (DecodeBit<18>(p+ssep+ssep+ssep))
-      {
-        counter0[ctx].Update1();
-        counter1[c1][ctx].Update1();
-        counter2[f][ctx][j].Update1();
-        counter2[f][ctx][j+1].Update1();
+// Dictionaries - a snapshot of the model after coding a training corpus,
+// so small files start from primed counters instead of p=0.5. The file is
+// "BCMD", U32 version, U32 ID (CRC32 of the snapshot), U32 reserved, then
+// the counters as they are in memory (little-endian), so it can be mapped
+// and shared by any number of processes
 
-        ctx+=ctx+1;
-      }
-      else
-      {
-        counter0[ctx].Update0();
-        counter1[c1][ctx].Update0();
-        counter2[f][ctx][j].Update0();
-        counter2[f][ctx][j+1].Update0();
+struct Dict
+{
+  enum
+  {
+    HEAD=16,
+    SIZE=sizeof(Counter<2>[256])+sizeof(Counter<4>[256][256])+sizeof(Counter<6>[2][256][17])
+  };
 
-        ctx+=ctx;
-      }
-    }
+  U32 id;
+  const U8* snap; // Null - no dictionary
+  U8* mem;
+  size_t len;
 
-    c2=c1;
-    c1=ctx-256;
+  void Load(const char* name);
+  void Save(const CM& cm, const char* name);
+};
 
-    if (c1==c2)
-      ++run;
-    else
-      run=0;
+Dict dict;
 
-    return c1;
-  }
-} cm;
+// Buffers are hashed by the fastest kernel the CPU has, all give the same
+// result - slicing by 8 everywhere, carry-less multiply folding on x86
 
 struct CRC
 {
-  U32 tab[256];
+  static U32 tab[8][256];
+  static U32 (*fold)(U32 crc, const U8* buf, size_t n);
   U32 crc;
 
   CRC()
+  {
+    crc=U32(-1);
+  }
+
+  static void Init()
   {
     for (int i=0; i<256; ++i)
     {
       U32 r=i;
       for (int j=0; j<8; ++j)
         r=(r>>1)^(0xEDB88320&-int(r&1));
-      tab[i]=r;
+      tab[0][i]=r;
     }
-    crc=U32(-1);
+    for (int i=0; i<256; ++i)
+    {
+      for (int j=1; j<8; ++j)
+        tab[j][i]=(tab[j-1][i]>>8)^tab[0][tab[j-1][i]&255];
+    }
+
+    fold=Slice8;
+#ifdef HAVE_CLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+      fold=Clmul;
+#endif
   }
 
   U32 operator()() const
@@ -314,274 +522,4118 @@ struct CRC
 
   void Update(int c)
   {
-    crc=(crc>>8)^tab[(crc^c)&255];
+    crc=(crc>>8)^tab[0][(crc^c)&255];
   }
 
-  void Update(U8* buf, int n)
+  void Update(const U8* buf, size_t n)
   {
-    for (int i=0; i<n; ++i)
-      crc=(crc>>8)^tab[(crc^buf[i])&255];
+    crc=fold(crc, buf, n);
   }
-} crc;
 
-template<typename T>
-inline T* MemAlloc(size_t n)
-{
-  T* p=(T*)malloc(n*sizeof(T));
-  if (!p)
+  static U32 Slice8(U32 crc, const U8* buf, size_t n)
   {
-    perror("Malloc() failed");
-    exit(1);
+    for (; n>=8; n-=8, buf+=8)
+    {
+      const U32 a=crc^(buf[0]|(buf[1]<<8)|(buf[2]<<16)|(U32(buf[3])<<24));
+      const U32 b=buf[4]|(buf[5]<<8)|(buf[6]<<16)|(U32(buf[7])<<24);
+      crc=tab[7][a&255]^tab[6][(a>>8)&255]^tab[5][(a>>16)&255]^tab[4][a>>24]
+          ^tab[3][b&255]^tab[2][(b>>8)&255]^tab[1][(b>>16)&255]^tab[0][b>>24];
+    }
+    for (; n>0; --n)
+      crc=(crc>>8)^tab[0][(crc^*buf++)&255];
+    return crc;
   }
-  return p;
-}
 
-void Compress(int level)
-{
-  const int tab[10]=
-  {
-    0,
-    1<<20,      // -1 - 1 MB
-    1<<22,      // -2 - 4 MB
-    1<<23,      // -3 - 8 MB
-    0x00FFFFFF, // -4 - ~16 MB (Default)
-    1<<25,      // -5 - 32 MB
-    1<<26,      // -6 - 64 MB
-    1<<27,      // -7 - 128 MB
-    1<<28,      // -8 - 256 MB
-    0x7FFFFFFF, // -9 - ~2 GB
-  };
-  int bsize=tab[level]; // Block size
+#ifdef HAVE_CLMUL
+  // Fold 64 bytes at a time by x^512 and x^576 mod P, then down to 128
+  // bits, 64 bits, and a Barrett reduction to 32 bits (Intel's "Fast CRC
+  // Computation Using PCLMULQDQ", bit-reflected)
 
-  if (_fseeki64(in, 0, SEEK_END))
-  {
-    perror("Fseek() failed");
-    exit(1);
-  }
-  const S64 flen=_ftelli64(in);
-  if (flen<0)
+  __attribute__((target("pclmul,sse4.1")))
+  static U32 Clmul(U32 crc, const U8* buf, size_t n)
   {
-    perror("Ftell() failed");
-    exit(1);
-  }
-  rewind(in);
+    if (n<64)
+      return Slice8(crc, buf, n);
 
-  if (bsize>flen)
-    bsize=int(flen);
+    const __m128i k1k2=_mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4=_mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0=_mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly=_mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask=_mm_setr_epi32(-1, 0, -1, 0);
 
-  U8* buf=MemAlloc<U8>(bsize);
-  int* ptr=MemAlloc<int>(bsize);
+    __m128i x1=_mm_loadu_si128((const __m128i*)(buf));
+    __m128i x2=_mm_loadu_si128((const __m128i*)(buf+16));
+    __m128i x3=_mm_loadu_si128((const __m128i*)(buf+32));
+    __m128i x4=_mm_loadu_si128((const __m128i*)(buf+48));
+    x1=_mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+    buf+=64;
+    n-=64;
 
-  int n;
-  while ((n=fread(buf, 1, bsize, in))>0)
-  {
-    crc.Update(buf, n);
+    for (; n>=64; n-=64, buf+=64)
+    {
+      const __m128i x5=_mm_clmulepi64_si128(x1, k1k2, 0x00);
+      const __m128i x6=_mm_clmulepi64_si128(x2, k1k2, 0x00);
+      const __m128i x7=_mm_clmulepi64_si128(x3, k1k2, 0x00);
+      const __m128i x8=_mm_clmulepi64_si128(x4, k1k2, 0x00);
+      x1=_mm_clmulepi64_si128(x1, k1k2, 0x11);
+      x2=_mm_clmulepi64_si128(x2, k1k2, 0x11);
+      x3=_mm_clmulepi64_si128(x3, k1k2, 0x11);
+      x4=_mm_clmulepi64_si128(x4, k1k2, 0x11);
+      x1=_mm_xor_si128(_mm_xor_si128(x1, x5),
+          _mm_loadu_si128((const __m128i*)(buf)));
+      x2=_mm_xor_si128(_mm_xor_si128(x2, x6),
+          _mm_loadu_si128((const __m128i*)(buf+16)));
+      x3=_mm_xor_si128(_mm_xor_si128(x3, x7),
+          _mm_loadu_si128((const __m128i*)(buf+32)));
+      x4=_mm_xor_si128(_mm_xor_si128(x4, x8),
+          _mm_loadu_si128((const __m128i*)(buf+48)));
+    }
 
-    const int idx=libsais_bwt(buf, buf, ptr, n);
-    if (idx<1)
+    x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2),
+        _mm_clmulepi64_si128(x1, k3k4, 0x00));
+    x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3),
+        _mm_clmulepi64_si128(x1, k3k4, 0x00));
+    x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4),
+        _mm_clmulepi64_si128(x1, k3k4, 0x00));
+
+    for (; n>=16; n-=16, buf+=16)
     {
-      fprintf(stderr, "BWT() failed: idx = %d\n", idx);
-      exit(1);
+      x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11),
+          _mm_loadu_si128((const __m128i*)buf)),
+          _mm_clmulepi64_si128(x1, k3k4, 0x00));
     }
 
-    cm.Put32(n); // Block size
-    cm.Put32(idx); // BWT index
+    x2=_mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1=_mm_xor_si128(_mm_srli_si128(x1, 8), x2);
 
-    for (int i=0; i<n; ++i)
-      cm.Put(buf[i]);
+    x2=_mm_srli_si128(x1, 4);
+    x1=_mm_and_si128(x1, mask);
+    x1=_mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+    x2=_mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+    x2=_mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+    x1=_mm_xor_si128(x1, x2);
 
-    fprintf(stderr, "%lld -> %lld\r", _ftelli64(in), _ftelli64(out));
+    return Slice8(U32(_mm_extract_epi32(x1, 1)), buf, n);
   }
+#endif
+};
 
-  cm.Put32(0); // EOF
-  cm.Put32(crc()); // CRC32
+U32 CRC::tab[8][256];
+U32 (*CRC::fold)(U32 crc, const U8* buf, size_t n);
 
-  cm.Flush();
+#ifdef HAVE_HUGEPAGES
+const size_t HUGE_PAGE=size_t(1)<<21; // 2 MB
 
-  free(buf);
-  free(ptr);
+inline size_t HugeSize(size_t size)
+{
+  return (size+HUGE_PAGE-1)&~(HUGE_PAGE-1);
 }
 
-void Decompress()
+// Large tables are mapped 2 MB aligned and backed by huge pages where
+// possible - the BWT and the inverse BWT hit them at random
+
+void* HugeAlloc(size_t size)
 {
-  int cnt[257];
+  size=HugeSize(size);
+
+#  ifdef USE_HUGETLB
+  void* p=mmap(nullptr, size, PROT_READ|PROT_WRITE,
+      MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+  if (p!=MAP_FAILED)
+    return p;
+#  endif
 
-  int bsize=0;
-  U8* buf=nullptr;
-  U32* ptr=nullptr;
+  U8* q=(U8*)mmap(nullptr, size+HUGE_PAGE, PROT_READ|PROT_WRITE,
+      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (q==(U8*)MAP_FAILED)
+    return nullptr;
 
-  cm.Init();
+  const size_t head=(HUGE_PAGE-(size_t(q)&(HUGE_PAGE-1)))&(HUGE_PAGE-1);
+  if (head)
+    munmap(q, head);
+  munmap(q+head+size, HUGE_PAGE-head);
+  q+=head;
 
-  int n;
-  while ((n=cm.Get32())>0)
-  {
-    if (!bsize)
-    {
-      if ((bsize=n)>=(1<<24)) // 5*N
-        buf=MemAlloc<U8>(bsize);
-      ptr=MemAlloc<U32>(bsize);
-    }
+#  ifdef MADV_HUGEPAGE
+  madvise(q, size, MADV_HUGEPAGE); // Transparent huge pages, if enabled
+#  endif
 
-    const int idx=cm.Get32();
-    if (n>bsize || idx<1 || idx>n)
-    {
-      fprintf(stderr, "Corrupt input!\n");
-      exit(1);
-    }
+  return q;
+}
+#endif
 
-    // Inverse BW-transform
+#ifdef HAVE_HUGEPAGES
+// Daemon workers keep big tables they free mapped, and so faulted in, for
+// the next job. A map is lent for a table of 1/2 its size or more
 
-    if (n>=(1<<24)) // 5*N
-    {
-      memset(cnt, 0, sizeof(cnt));
-      for (int i=0; i<n; ++i)
-        ++cnt[(buf[i]=cm.Get())+1];
-      for (int i=1; i<256; ++i)
-        cnt[i]+=cnt[i-1];
+struct Stash
+{
+  struct Map
+  {
+    void* p;
+    size_t size;
+  };
 
-      for (int i=0; i<idx; ++i)
-        ptr[cnt[buf[i]]++]=i;
-      for (int i=idx+1; i<=n; ++i)
-        ptr[cnt[buf[i-1]]++]=i;
+  std::mutex lock;
+  std::vector<Map> kept;
+  std::vector<Map> lent;
+  size_t most; // Maps kept, 0 - none
 
-      int p=idx;
-      for (int i=0; i<n; ++i)
+  void* Take(size_t size)
+  {
+    std::lock_guard<std::mutex> l(lock);
+    for (size_t i=0; i<kept.size(); ++i)
+    {
+      if (kept[i].size>=size && kept[i].size/2<=size)
       {
-        p=ptr[p-1];
-        const int c=buf[p-(p>=idx)];
-        crc.Update(c);
-        putc(c, out);
+        lent.push_back(kept[i]);
+        kept.erase(kept.begin()+i);
+        return lent.back().p;
       }
     }
-    else // 4*N
-    {
-      memset(cnt, 0, sizeof(cnt));
-      for (int i=0; i<n; ++i)
-        ++cnt[(ptr[i]=cm.Get())+1];
-      for (int i=1; i<256; ++i)
-        cnt[i]+=cnt[i-1];
-
-      for (int i=0; i<idx; ++i)
-        ptr[cnt[ptr[i]&255]++]|=i<<8;
-      for (int i=idx+1; i<=n; ++i)
-        ptr[cnt[ptr[i-1]&255]++]|=i<<8;
+    return nullptr;
+  }
 
-      int p=idx;
-      for (int i=0; i<n; ++i)
+  void Keep(void* p, size_t size)
+  {
+    std::lock_guard<std::mutex> l(lock);
+    for (size_t i=0; i<lent.size(); ++i)
+    {
+      if (lent[i].p==p)
       {
-        p=ptr[p-1]>>8;
-        const int c=ptr[p-(p>=idx)];
-        crc.Update(c);
-        putc(c, out);
+        size=lent[i].size;
+        lent.erase(lent.begin()+i);
+        break;
       }
     }
-
-    fprintf(stderr, "%lld -> %lld\r", _ftelli64(in), _ftelli64(out));
+    if (kept.size()<most)
+      kept.push_back({p, size});
+    else
+      munmap(p, size);
   }
+};
 
-  if (cm.Get32()!=crc())
-  {
-    fprintf(stderr, "CRC error!\n");
-    exit(1);
-  }
+Stash stash;
+#endif
 
-  if (buf)
-    free(buf);
-  free(ptr);
-}
+// NUMA placement (--numa, --cpus) - the pool's threads are pinned and put
+// in groups, one per node. A thread steals from its own group first. Each
+// of the two blocks in flight prefers the memory of one node and is given
+// to that node's threads, so the BWT and the LF walk stay on local memory
 
-int main(int argc, char** argv)
+struct Topology
 {
-  const clock_t start=clock();
+  std::vector<std::vector<int> > cpu; // CPUs of each group
+  std::vector<int> node; // Node of each group, -1 - any
 
-  int level=4;
-  int decompress=0;
-  int overwrite=0;
-
-  while (argc>1 && *argv[1]=='-')
+  static int Parse(const char* s, std::vector<int>& v) // "0-3,8"
   {
-    for (int i=1; argv[1][i]!='\0'; ++i)
+    while (*s!='\0' && *s!='\n')
     {
-      switch (argv[1][i])
+      char* p;
+      const long a=strtol(s, &p, 10);
+      long b=a;
+      if (p==s || a<0)
+        return 0;
+      if (*p=='-')
       {
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-        level=argv[1][i]-'0';
-        break;
-      case 'd':
-        decompress=1;
-        break;
-      case 'f':
-        overwrite=1;
-        break;
-      default:
-        fprintf(stderr, "Unknown option '-%c'\n", argv[1][i]);
-        exit(1);
+        s=p+1;
+        b=strtol(s, &p, 10);
+        if (p==s || b<a || b-a>=65536)
+          return 0;
       }
+      for (long i=a; i<=b; ++i)
+        v.push_back(int(i));
+      s=p;
+      if (*s==',')
+        ++s;
+      else if (*s!='\0' && *s!='\n')
+        return 0;
     }
-
-    --argc;
-    ++argv;
+    return 1;
   }
 
-  if (argc<2)
+  static int ParseFile(const char* name, std::vector<int>& v)
   {
-    fprintf(stderr,
-        "BCM - A BWT-based file compressor, v1.60\n"
-        "Copyright (C) 2008-2021 Ilya Muravyov\n"
-        "\n"
-        "Usage: BCM [options] infile [outfile]\n"
-        "\n"
-        "Options:\n"
-        "  -1 .. -9 Set block size to 1 MB .. 2 GB\n"
-        "  -d       Decompress\n"
-        "  -f       Force overwrite of output file\n");
-    exit(1);
+    FILE* f=fopen(name, "r");
+    if (!f)
+      return 0;
+    char line[4096];
+    const int ok=fgets(line, sizeof(line), f) && Parse(line, v);
+    fclose(f);
+    return ok;
   }
 
-  in=fopen(argv[1], "rb");
-  if (!in)
-  {
-    perror(argv[1]);
-    exit(1);
-  }
+  // Returns the number of CPUs to use
 
-  char ofname[FILENAME_MAX];
-  if (argc<3)
+  int Init()
   {
-    strcpy(ofname, argv[1]);
-    if (decompress)
+    std::vector<int> allowed;
+    if (cpus)
     {
-      const int p=strlen(ofname)-4;
-      if (p>0 && !strcmp(&ofname[p], ".bcm"))
-        ofname[p]='\0';
-      else
-        strcat(ofname, ".out");
+      if (!Parse(cpus, allowed) || allowed.empty())
+      {
+        fprintf(stderr, "Invalid CPU list '%s'\n", cpus);
+        exit(1);
+      }
     }
+#ifdef HAVE_NUMA
     else
-      strcat(ofname, ".bcm");
-  }
-  else
-    strcpy(ofname, argv[2]);
-
-  if (!overwrite)
-  {
-    FILE* f=fopen(ofname, "rb");
-    if (f)
     {
-      fclose(f);
-
-      fprintf(stderr, "File '%s' already exists. Overwrite (y/n)? ", ofname);
-      fflush(stderr);
-
-      if (getchar()!='y')
+      cpu_set_t set;
+      if (!sched_getaffinity(0, sizeof(set), &set))
+      {
+        for (int i=0; i<CPU_SETSIZE; ++i)
+        {
+          if (CPU_ISSET(i, &set))
+            allowed.push_back(i);
+        }
+      }
+    }
+
+    std::vector<int> online;
+    if (numa && ParseFile("/sys/devices/system/node/online", online))
+    {
+      for (size_t i=0; i<online.size() && online[i]<1024; ++i)
+      {
+        char name[64];
+        sprintf(name, "/sys/devices/system/node/node%d/cpulist", online[i]);
+        std::vector<int> all;
+        std::vector<int> c;
+        ParseFile(name, all);
+        for (size_t j=0; j<all.size(); ++j)
+        {
+          if (std::find(allowed.begin(), allowed.end(), all[j])!=allowed.end())
+            c.push_back(all[j]);
+        }
+        if (!c.empty())
+        {
+          cpu.push_back(c);
+          node.push_back(online[i]);
+        }
+      }
+    }
+#endif
+
+    if (cpu.empty())
+    {
+      cpu.push_back(allowed);
+      node.push_back(-1);
+    }
+    return int(allowed.size());
+  }
+
+  int Group(int i, int n) const // Of thread i of n
+  {
+    return int(S64(i)*S64(cpu.size())/n);
+  }
+
+  void Pin(int i, int n) const
+  {
+#ifdef HAVE_NUMA
+    const std::vector<int>& c=cpu[Group(i, n)];
+    if ((!cpus && !numa) || c.empty())
+      return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (numa) // Anywhere on the node
+    {
+      for (size_t j=0; j<c.size(); ++j)
+        CPU_SET(c[j], &set);
+    }
+    else
+      CPU_SET(c[i%c.size()], &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+  }
+
+  // Pages of p are to come from the node of group g, as they are touched
+
+  void Prefer(void* p, size_t size, int g) const
+  {
+#ifdef HAVE_NUMA
+    if (g<0 || node.size()<2)
+      return;
+
+    const int d=node[g%node.size()];
+    unsigned long mask[1024/(8*sizeof(long))];
+    memset(mask, 0, sizeof(mask));
+    mask[d/(8*sizeof(long))]|=1UL<<(d%(8*sizeof(long)));
+    syscall(__NR_mbind, p, size, 1, mask, sizeof(mask)*8, 0); // MPOL_PREFERRED
+#endif
+  }
+};
+
+Topology topo;
+
+// g - the group whose node should hold the memory, -1 - any
+
+template<typename T>
+inline T* MemAlloc(size_t n, int g=-1)
+{
+#ifdef HAVE_HUGEPAGES
+  if (n*sizeof(T)>=HUGE_PAGE)
+  {
+    if (stash.most)
+    {
+      T* p=(T*)stash.Take(HugeSize(n*sizeof(T)));
+      if (p)
+        return p;
+    }
+
+    T* p=(T*)HugeAlloc(n*sizeof(T));
+    if (!p)
+    {
+      perror("Mmap() failed");
+      exit(1);
+    }
+    topo.Prefer(p, HugeSize(n*sizeof(T)), g);
+    return p;
+  }
+#endif
+
+  T* p=(T*)malloc(n*sizeof(T));
+  if (!p)
+  {
+    perror("Malloc() failed");
+    exit(1);
+  }
+  return p;
+}
+
+template<typename T>
+inline void MemFree(T* p, size_t n)
+{
+#ifdef HAVE_HUGEPAGES
+  if (n*sizeof(T)>=HUGE_PAGE)
+  {
+    if (stash.most)
+      stash.Keep(p, HugeSize(n*sizeof(T)));
+    else
+      munmap(p, HugeSize(n*sizeof(T)));
+    return;
+  }
+#endif
+
+  free(p);
+}
+
+// Work-stealing thread pool
+// Each thread has its own deque of block tasks: it pops the newest one and
+// idle threads steal the oldest. Whole files wait in a shared queue that
+// only idle threads take from, so a thread waiting for its own blocks helps
+// with blocks but never starts another file
+
+struct Pool
+{
+  struct Deque
+  {
+    std::mutex lock;
+    std::deque<std::function<void()> > q;
+  };
+
+  int n; // Threads, the main one included
+  Deque* local;
+  int* group; // Of each thread, see Topology
+  std::atomic<int> turn; // Next thread of a group to give a task
+  Deque files;
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable cv;
+  std::atomic<int> queued; // Block tasks in the deques
+  std::atomic<int> waiting; // Files in the queue
+  std::atomic<int> pending; // Files not done yet
+  int quit;
+
+  static thread_local int self;
+
+  void Start(int t)
+  {
+    n=t;
+    local=new Deque[n];
+    group=new int[n];
+    for (int i=0; i<n; ++i)
+      group[i]=topo.Group(i, n);
+    turn=0;
+    queued=0;
+    waiting=0;
+    pending=0;
+    quit=0;
+
+    self=0;
+    topo.Pin(0, n);
+    for (int i=1; i<n; ++i)
+      workers.push_back(std::thread(&Pool::Worker, this, i));
+  }
+
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> l(lock);
+      quit=1;
+    }
+    cv.notify_all();
+
+    for (size_t i=0; i<workers.size(); ++i)
+      workers[i].join();
+    delete[] local;
+    delete[] group;
+  }
+
+  void Notify()
+  {
+    {
+      std::lock_guard<std::mutex> l(lock);
+    }
+    cv.notify_all();
+  }
+
+  static int Pop(Deque& d, int newest, std::function<void()>& f)
+  {
+    std::lock_guard<std::mutex> l(d.lock);
+    if (d.q.empty())
+      return 0;
+
+    if (newest)
+    {
+      f.swap(d.q.back());
+      d.q.pop_back();
+    }
+    else
+    {
+      f.swap(d.q.front());
+      d.q.pop_front();
+    }
+    return 1;
+  }
+
+  int RunOne(int file)
+  {
+    std::function<void()> f;
+    int found=Pop(local[self], 1, f);
+    for (int i=1; i<n && !found; ++i) // The own group first
+    {
+      if (group[(self+i)%n]==group[self])
+        found=Pop(local[(self+i)%n], 0, f);
+    }
+    for (int i=1; i<n && !found; ++i)
+    {
+      if (group[(self+i)%n]!=group[self])
+        found=Pop(local[(self+i)%n], 0, f);
+    }
+
+    if (found)
+      --queued;
+    else if (file && (found=Pop(files, 0, f))!=0)
+      --waiting;
+
+    if (found)
+      f();
+    return found;
+  }
+
+  void Worker(int i)
+  {
+    self=i;
+    topo.Pin(i, n);
+    for (;;)
+    {
+      if (RunOne(1))
+        continue;
+
+      std::unique_lock<std::mutex> l(lock);
+      if (quit)
+        break;
+      if (!queued && !waiting)
+        cv.wait(l);
+    }
+  }
+
+  // Run f as a block task, done is set when it's finished. With g, it goes
+  // to a thread of group g, if there is one
+
+  void Spawn(std::atomic<int>& done, std::function<void()> f, int g=-1)
+  {
+    done=0;
+    if (n<=1)
+    {
+      f();
+      done=1;
+      return;
+    }
+
+    int t=self;
+    if (g>=0 && group[n-1]>0 && (g%=group[n-1]+1)!=group[self])
+    {
+      int m=0; // Threads of the group
+      for (int i=0; i<n; ++i)
+        m+=(group[i]==g);
+      for (int i=0, k=m?(turn++)%m:-1; i<n; ++i)
+      {
+        if (group[i]==g && k--==0)
+          t=i;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> l(local[t].lock);
+      local[t].q.push_back([this, &done, f]()
+      {
+        f();
+        done=1;
+        Notify();
+      });
+    }
+    ++queued;
+    Notify();
+  }
+
+  void Wait(std::atomic<int>& done)
+  {
+    while (!done)
+    {
+      if (RunOne(0))
+        continue;
+
+      std::unique_lock<std::mutex> l(lock);
+      if (!done && !queued)
+        cv.wait(l);
+    }
+  }
+
+  void Submit(std::function<void()> f)
+  {
+    if (n<=1)
+    {
+      f();
+      return;
+    }
+
+    ++pending;
+    {
+      std::lock_guard<std::mutex> l(files.lock);
+      files.q.push_back([this, f]()
+      {
+        f();
+        --pending;
+        Notify();
+      });
+    }
+    ++waiting;
+    Notify();
+  }
+
+  void Drain()
+  {
+    while (pending)
+    {
+      if (RunOne(1))
+        continue;
+
+      std::unique_lock<std::mutex> l(lock);
+      if (pending && !queued && !waiting)
+        cv.wait(l);
+    }
+  }
+};
+
+Pool& pool=*new Pool; // Never destroyed - exit() may come from any thread
+
+thread_local int Pool::self=0;
+
+// Physical memory in bytes, 0 - unknown
+
+S64 PhysMem()
+{
+#ifdef _MSC_VER
+  return 0;
+#else
+  const long pages=sysconf(_SC_PHYS_PAGES);
+  const long page=sysconf(_SC_PAGESIZE);
+  return (pages>0 && page>0)?S64(pages)*page:0;
+#endif
+}
+
+// Blocks in flight - with more than one thread, the next block is sorted
+// (or decoded) while this one is coded (or unpacked), which takes twice the
+// memory. That's done only while both sets of need bytes fit in half of the
+// RAM
+
+int Depth(S64 need)
+{
+  const S64 mem=PhysMem();
+  return (pool.n>1 && need>0 && need<=mem/4)?2:1;
+}
+
+// libsais contexts are kept per thread, across blocks and files
+
+struct SaisCtx
+{
+  void* ctx;
+  void* ctx64;
+
+  ~SaisCtx()
+  {
+    libsais_free_ctx(ctx);
+    libsais64_free_ctx(ctx64);
+  }
+
+  void* Get(int wide)
+  {
+    void*& p=wide?ctx64:ctx;
+    if (!p && !(p=wide?libsais64_create_ctx():libsais_create_ctx()))
+    {
+      fprintf(stderr, "BWT() failed: out of memory\n");
+      exit(1);
+    }
+    return p;
+  }
+};
+
+thread_local SaisCtx sais;
+
+// Asynchronous I/O of the raw data - the stream is cut into chunks and
+// several of them are in flight at a time. On Linux they go through
+// io_uring, with the chunks registered as fixed buffers; elsewhere, or if
+// the kernel won't have it, through a thread of their own
+
+struct AsyncIO
+{
+  enum
+  {
+    CHUNK=1<<20,
+    DEPTH=4
+  };
+
+  FILE* f;
+  int writing;
+  U8* buf[DEPTH];
+  S64 at[DEPTH]; // File offset
+  int len[DEPTH]; // Bytes to write
+  int res[DEPTH]; // Bytes done, or -errno
+  int busy[DEPTH];
+  S64 base; // Offset of the data
+  S64 off; // Offset of the next chunk
+  S64 done; // Bytes read or written so far
+  int cur; // Chunk being drained or filled
+  int pos;
+  int fill; // Bytes in the current chunk when reading, -1 - not yet known
+
+  std::thread io;
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<int> queue;
+  int quit;
+
+#ifdef HAVE_IO_URING
+  int ring; // -1 - use the thread
+  int fixed;
+  void* sq_ptr;
+  size_t sq_len;
+  void* cq_ptr;
+  size_t cq_len;
+  io_uring_sqe* sqes;
+  size_t sqes_len;
+  U32* sq_tail;
+  U32* sq_mask;
+  U32* sq_array;
+  U32* cq_head;
+  U32* cq_tail;
+  U32* cq_mask;
+  io_uring_cqe* cqes;
+
+  int Setup()
+  {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring=int(syscall(__NR_io_uring_setup, DEPTH, &p));
+    if (ring<0)
+      return 0;
+
+    sq_len=p.sq_off.array+p.sq_entries*sizeof(U32);
+    cq_len=p.cq_off.cqes+p.cq_entries*sizeof(io_uring_cqe);
+    if (p.features&IORING_FEAT_SINGLE_MMAP)
+      sq_len=cq_len=(sq_len>cq_len?sq_len:cq_len);
+    sqes_len=p.sq_entries*sizeof(io_uring_sqe);
+
+    sq_ptr=mmap(nullptr, sq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+        ring, IORING_OFF_SQ_RING);
+    cq_ptr=(p.features&IORING_FEAT_SINGLE_MMAP)?sq_ptr
+        :mmap(nullptr, cq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+        ring, IORING_OFF_CQ_RING);
+    void* q=mmap(nullptr, sqes_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+        ring, IORING_OFF_SQES);
+    if (sq_ptr==MAP_FAILED || cq_ptr==MAP_FAILED || q==MAP_FAILED)
+    {
+      if (sq_ptr!=MAP_FAILED)
+        munmap(sq_ptr, sq_len);
+      if (cq_ptr!=MAP_FAILED && cq_ptr!=sq_ptr)
+        munmap(cq_ptr, cq_len);
+      if (q!=MAP_FAILED)
+        munmap(q, sqes_len);
+      close(ring);
+      ring=-1;
+      return 0;
+    }
+    sqes=(io_uring_sqe*)q;
+
+    U8* sq=(U8*)sq_ptr;
+    sq_tail=(U32*)(sq+p.sq_off.tail);
+    sq_mask=(U32*)(sq+p.sq_off.ring_mask);
+    sq_array=(U32*)(sq+p.sq_off.array);
+    U8* cq=(U8*)cq_ptr;
+    cq_head=(U32*)(cq+p.cq_off.head);
+    cq_tail=(U32*)(cq+p.cq_off.tail);
+    cq_mask=(U32*)(cq+p.cq_off.ring_mask);
+    cqes=(io_uring_cqe*)(cq+p.cq_off.cqes);
+
+    iovec iov[DEPTH];
+    for (int i=0; i<DEPTH; ++i)
+    {
+      iov[i].iov_base=buf[i];
+      iov[i].iov_len=CHUNK;
+    }
+    fixed=(syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, iov, DEPTH)==0);
+    return 1;
+  }
+
+  void Enter(int submit, int wait)
+  {
+    while (syscall(__NR_io_uring_enter, ring, submit, wait,
+        wait?IORING_ENTER_GETEVENTS:0, nullptr, 0)<0)
+    {
+      if (errno!=EINTR)
+      {
+        perror("Io_uring_enter() failed");
+        exit(1);
+      }
+    }
+  }
+#endif
+
+  void Open(FILE* file, int w)
+  {
+    f=file;
+    writing=w;
+    if (writing)
+      fflush(f);
+    base=off=_ftelli64(f);
+    const int pipe=(base<0); // Only the thread reads a pipe, in order
+    if (pipe)
+      base=off=0;
+    done=0;
+    cur=0;
+    pos=0;
+    fill=-1;
+    quit=0;
+
+    U8* mem=MemAlloc<U8>(S64(CHUNK)*DEPTH);
+    for (int i=0; i<DEPTH; ++i)
+    {
+      buf[i]=&mem[S64(CHUNK)*i];
+      busy[i]=0;
+    }
+
+#ifdef HAVE_IO_URING
+    ring=-1;
+    if (pipe || !Setup())
+#endif
+      io=std::thread(&AsyncIO::Thread, this);
+
+    if (!writing) // Read ahead
+    {
+      for (int i=0; i<DEPTH; ++i)
+        Submit(i);
+    }
+  }
+
+  void Close()
+  {
+    for (int i=0; i<DEPTH; ++i)
+    {
+      if (busy[i])
+        Complete(i);
+    }
+
+#ifdef HAVE_IO_URING
+    if (ring>=0)
+    {
+      munmap(sqes, sqes_len);
+      if (cq_ptr!=sq_ptr)
+        munmap(cq_ptr, cq_len);
+      munmap(sq_ptr, sq_len);
+      close(ring);
+    }
+    else
+#endif
+    {
+      {
+        std::lock_guard<std::mutex> l(lock);
+        quit=1;
+      }
+      cv.notify_all();
+      io.join();
+    }
+
+    MemFree(buf[0], S64(CHUNK)*DEPTH);
+
+    // Leave the stream where the data ends, not where the reads got to
+
+    _fseeki64(f, base+done, SEEK_SET);
+  }
+
+  void Thread()
+  {
+    std::unique_lock<std::mutex> l(lock);
+    for (;;)
+    {
+      if (queue.empty())
+      {
+        if (quit)
+          break;
+        cv.wait(l);
+        continue;
+      }
+
+      const int i=queue.front();
+      queue.pop_front();
+      l.unlock();
+
+      // Chunks come in order, so the stream position is the right one
+
+      int r=writing?int(fwrite(buf[i], 1, len[i], f)):int(fread(buf[i], 1, CHUNK, f));
+      if (ferror(f))
+        r=-EIO;
+
+      l.lock();
+      res[i]=r;
+      busy[i]=0;
+      cv.notify_all();
+    }
+  }
+
+  void Submit(int i)
+  {
+    at[i]=off;
+    off+=writing?len[i]:CHUNK;
+    busy[i]=1;
+
+#ifdef HAVE_IO_URING
+    if (ring>=0)
+    {
+      const U32 tail=*sq_tail;
+      const U32 k=tail&*sq_mask;
+      io_uring_sqe* sqe=&sqes[k];
+      memset(sqe, 0, sizeof(*sqe));
+      if (fixed)
+        sqe->opcode=writing?IORING_OP_WRITE_FIXED:IORING_OP_READ_FIXED;
+      else
+        sqe->opcode=writing?IORING_OP_WRITE:IORING_OP_READ;
+      sqe->fd=fileno(f);
+      sqe->addr=U64(buf[i]);
+      sqe->len=writing?len[i]:CHUNK;
+      sqe->off=at[i];
+      sqe->buf_index=U16(i);
+      sqe->user_data=i;
+      sq_array[k]=k;
+      __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+      Enter(1, 0);
+      return;
+    }
+#endif
+
+    {
+      std::lock_guard<std::mutex> l(lock);
+      queue.push_back(i);
+    }
+    cv.notify_all();
+  }
+
+  int Complete(int i)
+  {
+#ifdef HAVE_IO_URING
+    if (ring>=0)
+    {
+      while (busy[i])
+      {
+        const U32 head=*cq_head;
+        if (head==__atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+          Enter(0, 1);
+          continue;
+        }
+        const io_uring_cqe* cqe=&cqes[head&*cq_mask];
+        res[cqe->user_data]=cqe->res;
+        busy[cqe->user_data]=0;
+        __atomic_store_n(cq_head, head+1, __ATOMIC_RELEASE);
+      }
+    }
+    else
+#endif
+    {
+      std::unique_lock<std::mutex> l(lock);
+      while (busy[i])
+        cv.wait(l);
+    }
+
+    if (res[i]<0)
+    {
+      errno=-res[i];
+      perror(writing?"Write() failed":"Read() failed");
+      exit(1);
+    }
+    return res[i];
+  }
+
+  S64 Read(U8* dst, S64 n)
+  {
+    S64 got=0;
+    while (n>0)
+    {
+      if (fill<0)
+        fill=Complete(cur);
+
+      const int k=int(n<fill-pos?n:fill-pos);
+      memcpy(&dst[got], &buf[cur][pos], k);
+      pos+=k;
+      got+=k;
+      n-=k;
+
+      if (pos==fill)
+      {
+        if (fill<CHUNK) // EOF
+          break;
+
+        Submit(cur);
+        cur=(cur+1)%DEPTH;
+        pos=0;
+        fill=-1;
+      }
+    }
+    done+=got;
+    return got;
+  }
+
+  void Put(int c)
+  {
+    if (pos==CHUNK)
+      Next();
+    buf[cur][pos++]=U8(c);
+  }
+
+  void Next()
+  {
+    len[cur]=pos;
+    Submit(cur);
+    done+=pos;
+    cur=(cur+1)%DEPTH;
+    pos=0;
+    if (busy[cur])
+      Check(cur);
+  }
+
+  void Check(int i)
+  {
+    if (Complete(i)!=len[i])
+    {
+      fprintf(stderr, "Write() failed: short write\n");
+      exit(1);
+    }
+  }
+
+  void Flush()
+  {
+    if (pos>0)
+      Next();
+    for (int i=0; i<DEPTH; ++i)
+    {
+      if (busy[i])
+        Check(i);
+    }
+  }
+};
+
+// Adaptive block boundaries
+// A block is cut where the order-0 statistics change, i.e. where the next
+// two windows cost much more with the block's model than with their own.
+// The cut is then moved to a nearby tar member or ELF header, if any
+
+const double SEG_DIVERGENCE=1.0; // Bits per byte
+
+void Histogram(const U8* buf, S64 n, U32* h)
+{
+  memset(h, 0, 256*sizeof(U32));
+  for (S64 i=0; i<n; ++i)
+    ++h[buf[i]];
+}
+
+double Divergence(const U32* h, S64 n, const U64* b, S64 m)
+{
+  double d=0;
+  for (int c=0; c<256; ++c)
+  {
+    if (h[c])
+      d+=h[c]*log2((double(h[c])/n)/((b[c]+0.5)/(m+128)));
+  }
+  return d/n;
+}
+
+int IsHeader(const U8* p, S64 pos)
+{
+  if (!(pos&511) && !memcmp(&p[257], "ustar", 5)) // tar member
+    return 1;
+  return !memcmp(p, "\177ELF", 4);
+}
+
+S64 Segment(const U8* buf, S64 n, S64 bsize, S64 pos)
+{
+  S64 w=bsize>>6; // Window size
+  if (w>(1<<20))
+    w=1<<20;
+  if (w<(1<<12))
+    w=1<<12;
+
+  U64 blk[256]={0};
+  U32 cur[256];
+  U32 nxt[256];
+
+  S64 i=0;
+  for (; i+w<=n; i+=w)
+  {
+    Histogram(&buf[i], w, cur);
+
+    if (i>=(bsize>>3) && Divergence(cur, w, blk, i)>SEG_DIVERGENCE)
+    {
+      if (i+w*2>n)
+        break;
+      Histogram(&buf[i+w], w, nxt);
+      if (Divergence(nxt, w, blk, i)>SEG_DIVERGENCE)
+        break;
+    }
+
+    for (int c=0; c<256; ++c)
+      blk[c]+=cur[c];
+  }
+
+  if (i+w>n)
+    return n;
+
+  // Snap to the nearest header within one window
+
+  S64 cut=i;
+  for (S64 j=0; j<w; ++j)
+  {
+    if (i+j+512<=n && IsHeader(&buf[i+j], pos+i+j))
+    {
+      cut=i+j;
+      break;
+    }
+    if (j<=i-(bsize>>3) && IsHeader(&buf[i-j], pos+i-j))
+    {
+      cut=i-j;
+      break;
+    }
+  }
+
+  return cut;
+}
+
+// Plain header, after the magic of a v3 stream - all fields little-endian:
+//   U8  level (0 - set by -b)
+//   U8  flags
+//   U64 block size
+//   U64 original size
+//   U64 offset of the block table from the magic, 0 - none
+//   U32 dictionary ID, if flags say so
+// The table follows the coded stream - U64 count, then U64 size and
+// U32 CRC32 per block. A file may hold several streams (members) back to
+// back, each decoding to the data that follows the one before
+
+enum
+{
+  HDR_ADAPTIVE=1,
+  HDR_DICT=2, // Followed by U32 ID of the dictionary
+  HDR_SMALL=4, // One block, see CompressSmall()
+  HDR_PARTS=8, // Blocks are coded in parts, see EncodeParts()
+  HDR_REF=16, // "BCMr" stream, see CompressRef()
+  HDR_DEDUP=32, // "BCMu" stream, see CompressDedup()
+  HDR_CODER=64 // Blocks in parts say their coder
+};
+
+struct Header
+{
+  int ver; // 1 - v1.60, 3 - plain header and block CRCs
+  int level;
+  int flags;
+  S64 bsize;
+  S64 size; // -1 - unknown
+  S64 table;
+  U32 dict;
+  U32 ref; // CRC32 of the reference
+  S64 rsize; // and its size
+  U32 crc; // CRC32 of a "BCMr" or "BCMu" stream's data
+};
+
+const int SMALL=1<<16; // Largest input coded by CompressSmall()
+
+void PutLE(FILE* f, U64 x, int n)
+{
+  for (int i=0; i<n; ++i)
+    putc(int(x>>(i*8))&255, f);
+}
+
+U64 GetLE(FILE* f, int n)
+{
+  U64 x=0;
+  for (int i=0; i<n; ++i)
+  {
+    const int c=getc(f);
+    if (c==EOF)
+    {
+      fprintf(stderr, "Unexpected end of file!\n");
+      exit(1);
+    }
+    x|=U64(c)<<(i*8);
+  }
+  return x;
+}
+
+void PutVar(FILE* f, U64 x)
+{
+  for (; x>=128; x>>=7)
+    putc(int(x&127)|128, f);
+  putc(int(x), f);
+}
+
+U64 GetVar(FILE* f)
+{
+  U64 x=0;
+  for (int i=0; i<64; i+=7)
+  {
+    const int c=getc(f);
+    if (c==EOF)
+      break;
+    x|=U64(c&127)<<i;
+    if (c<128)
+      return x;
+  }
+  fprintf(stderr, "Corrupt input!\n");
+  exit(1);
+}
+
+void WriteHeader(FILE* f, const Header& h)
+{
+  PutLE(f, h.level, 1);
+  PutLE(f, h.flags, 1);
+  PutLE(f, h.bsize, 8);
+  PutLE(f, h.size, 8);
+  PutLE(f, h.table, 8);
+  if (h.flags&HDR_DICT)
+    PutLE(f, h.dict, 4);
+}
+
+// Read the magic and, if there, the plain header. Returns 0 if not in BCM
+// format
+
+int ReadHeader(FILE* f, Header& h)
+{
+  char m[4];
+  if (fread(m, 1, 4, f)!=4 || memcmp(m, magic, 3))
+    return 0;
+
+  h.level=0;
+  h.flags=0;
+  h.bsize=0;
+  h.size=-1;
+  h.table=0;
+  h.dict=0;
+  h.ref=0;
+  h.rsize=0;
+  h.crc=0;
+
+  switch (m[3])
+  {
+  case '!':
+    h.ver=1;
+    break;
+  case '3':
+    h.ver=3;
+    h.level=int(GetLE(f, 1));
+    h.flags=int(GetLE(f, 1));
+    h.bsize=S64(GetLE(f, 8));
+    h.size=S64(GetLE(f, 8));
+    h.table=S64(GetLE(f, 8));
+    if (h.flags&HDR_DICT)
+      h.dict=U32(GetLE(f, 4));
+    if ((h.flags&HDR_SMALL) && (h.size<0 || h.size>SMALL || h.bsize!=h.size))
+      return 0;
+    break;
+  case 'r':
+    h.ver=3;
+    h.flags=int(GetLE(f, 1))|HDR_REF;
+    h.ref=U32(GetLE(f, 4));
+    h.rsize=S64(GetLE(f, 8));
+    h.size=S64(GetLE(f, 8));
+    h.crc=U32(GetLE(f, 4));
+    break;
+  case 'u':
+    h.ver=3;
+    h.flags=int(GetLE(f, 1))|HDR_DEDUP;
+    h.size=S64(GetLE(f, 8));
+    h.crc=U32(GetLE(f, 4));
+    break;
+  default:
+    return 0;
+  }
+
+  return 1;
+}
+
+void CompressSmall(FILE* in, FILE* out, int n);
+S64 DecompressSmall(FILE* in, FILE* out, const Header& h);
+S64 CompressRef(FILE* in, FILE* out);
+S64 DecompressRef(FILE* in, FILE* out, const Header& h);
+S64 CompressDedup(FILE* in, FILE* out);
+S64 DecompressDedup(FILE* in, FILE* out, const Header& h);
+int NextMember(FILE* in, S64& base, const Header& h);
+
+// Compression runs as a pipeline - while one block is being coded, the
+// next one is read and sorted by another thread
+
+struct Block
+{
+  U8* buf;
+  int* ptr;
+  int64_t* ptr64; // Blocks over 2 GB are sorted with 64-bit indices (9*N)
+  S64 avail; // Bytes read - the block and what follows it
+  S64 n;
+  S64 idx;
+  U32 crc;
+  int how; // Coder
+  double secs; // Time to sort
+  std::atomic<int> done;
+};
+
+// Reads up to bsize bytes into b, but not past end, if known
+
+void ReadBlock(Block& b, Block& prev, AsyncIO& in, S64 bsize, S64& pos, S64 end)
+{
+  const S64 rest=prev.avail-prev.n;
+  if (rest>0)
+    memmove(b.buf, &prev.buf[prev.n], rest);
+
+  S64 want=bsize-rest;
+  if (end>=0 && want>end-pos-rest)
+    want=end-pos-rest;
+  b.avail=rest+in.Read(&b.buf[rest], want);
+  b.n=adaptive?Segment(b.buf, b.avail, bsize, pos):b.avail;
+  pos+=b.n;
+}
+
+int Trial(const U8* buf, S64 n);
+
+void SortBlock(Block* b)
+{
+  const std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+
+  CRC crc;
+  crc.Update(b->buf, b->n);
+  b->crc=crc();
+
+  b->idx=b->ptr64?libsais64_bwt_ctx(sais.Get(1), b->buf, b->buf, b->ptr64, b->n, 0)
+      :libsais_bwt_ctx(sais.Get(0), b->buf, b->buf, b->ptr, int(b->n), 0);
+  if (b->idx<1)
+  {
+    fprintf(stderr, "BWT() failed: idx = %lld\n", b->idx);
+    exit(1);
+  }
+  b->how=(trial && coder==CODER_CM)?Trial(b->buf, b->n):coder;
+
+  b->secs=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+// Fast coder (--fast) - the BWT output is move-to-front coded, runs of
+// zeros are written as bijective base-2 digits (RUNA, RUNB) as in bzip2,
+// and the symbols are coded by a static rANS coder with two interleaved
+// states, in one of FAST_CTX contexts by the symbol before. A part is
+// varint count of symbols; for each context, varint count of the symbols
+// seen in it and, for each, varint gap from the one before and varint
+// frequency, scaled to RANS_M; two U32 states and the rANS bytes. Decoding
+// is a table lookup and a few shifts per symbol, against 8 binary codings
+// per byte for CM
+
+const int FAST_SYMS=257; // RUNA, RUNB, MTF ranks 1..255
+const int FAST_CTX=3;
+const int RANS_BITS=14;
+const U32 RANS_M=1<<RANS_BITS;
+const U32 RANS_L=1<<23;
+
+struct Fast
+{
+  static int Ctx(int c) // Of the symbol after c
+  {
+    return c<2?0:(c==2?1:2);
+  }
+
+  static void PutVar(std::vector<U8>& mem, U64 x)
+  {
+    for (; x>=128; x>>=7)
+      mem.push_back(U8(x|128));
+    mem.push_back(U8(x));
+  }
+
+  static U64 GetVar(const U8*& p, const U8* end)
+  {
+    U64 x=0;
+    for (int i=0; i<64 && p<end; i+=7)
+    {
+      const int c=*p++;
+      x|=U64(c&127)<<i;
+      if (c<128)
+        return x;
+    }
+    Corrupt();
+    return 0;
+  }
+
+  static void Corrupt()
+  {
+    fprintf(stderr, "Corrupt input!\n");
+    exit(1);
+  }
+
+  // Scales counts to frequencies that add up to RANS_M, or all 0, each seen
+  // symbol at least 1
+
+  static void Scale(const S64* cnt, U32* freq)
+  {
+    S64 k=0;
+    for (int i=0; i<FAST_SYMS; ++i)
+      k+=cnt[i];
+
+    S64 sum=0;
+    int top=0;
+    for (int i=0; i<FAST_SYMS; ++i)
+    {
+      freq[i]=k?U32(cnt[i]*RANS_M/k):0;
+      if (cnt[i] && !freq[i])
+        freq[i]=1;
+      sum+=freq[i];
+      if (freq[i]>freq[top])
+        top=i;
+    }
+    while (sum>RANS_M) // Take from the biggest
+    {
+      for (int i=0; i<FAST_SYMS; ++i)
+      {
+        if (freq[i]>freq[top])
+          top=i;
+      }
+      const U32 d=U32(sum-RANS_M<freq[top]/2?sum-RANS_M:freq[top]/2);
+      freq[top]-=d;
+      sum-=d;
+    }
+    if (k)
+      freq[top]+=U32(RANS_M-sum);
+  }
+
+  static void Encode(const U8* buf, S64 n, std::vector<U8>& mem)
+  {
+    std::vector<U16> sym;
+    sym.reserve(size_t(n));
+
+    U8 mtf[256];
+    for (int i=0; i<256; ++i)
+      mtf[i]=U8(i);
+
+    S64 run=0;
+    for (S64 i=0; i<=n; ++i)
+    {
+      int j=0;
+      if (i<n)
+      {
+        const U8 c=buf[i];
+        while (mtf[j]!=c)
+          ++j;
+        if (!j)
+        {
+          ++run;
+          continue;
+        }
+        memmove(&mtf[1], &mtf[0], j);
+        mtf[0]=c;
+      }
+
+      for (; run>0; run>>=1)
+      {
+        --run;
+        sym.push_back(U16(run&1));
+      }
+      if (j)
+        sym.push_back(U16(j+1));
+    }
+
+    const S64 k=S64(sym.size());
+    PutVar(mem, U64(k));
+    if (!k)
+      return;
+
+    S64 cnt[FAST_CTX][FAST_SYMS]={};
+    for (S64 i=0; i<k; ++i)
+      ++cnt[Ctx(i?sym[i-1]:0)][sym[i]];
+
+    U32 freq[FAST_CTX][FAST_SYMS];
+    U32 start[FAST_CTX][FAST_SYMS];
+    for (int j=0; j<FAST_CTX; ++j)
+    {
+      Scale(cnt[j], freq[j]);
+      int seen=0;
+      for (int i=0; i<FAST_SYMS; ++i)
+        seen+=(freq[j][i]>0);
+      PutVar(mem, seen);
+      for (int i=0, c=0, last=-1; i<FAST_SYMS; ++i)
+      {
+        if (freq[j][i])
+        {
+          PutVar(mem, i-last-1);
+          PutVar(mem, freq[j][i]);
+          last=i;
+        }
+        start[j][i]=U32(c);
+        c+=freq[j][i];
+      }
+    }
+
+    // rANS goes backwards, so the decoder reads forwards
+
+    std::vector<U8> out(size_t(k)*2+8);
+    size_t p=out.size();
+    U32 st[2]={RANS_L, RANS_L};
+    for (S64 i=k-1; i>=0; --i)
+    {
+      U32& x=st[i&1];
+      const int j=Ctx(i?sym[i-1]:0);
+      const int c=sym[i];
+      const U32 f=freq[j][c];
+      const U32 most=((RANS_L>>RANS_BITS)<<8)*f;
+      while (x>=most)
+      {
+        out[--p]=U8(x);
+        x>>=8;
+      }
+      x=((x/f)<<RANS_BITS)+(x%f)+start[j][c];
+    }
+    for (int j=1; j>=0; --j)
+    {
+      for (int i=3; i>=0; --i)
+        out[--p]=U8(st[j]>>(i*8));
+    }
+    mem.insert(mem.end(), out.begin()+p, out.end());
+  }
+
+  static void Decode(const U8* p, const U8* end, U8* dst, S64 n)
+  {
+    const S64 k=S64(GetVar(p, end));
+    U32 freq[FAST_CTX][FAST_SYMS];
+    U32 start[FAST_CTX][FAST_SYMS];
+    const bool table=(k>=S64(RANS_M)); // Else searching costs less than filling
+    std::vector<U16> sym(table?FAST_CTX*RANS_M:1);
+    U16 used[FAST_CTX][FAST_SYMS]; // Symbols seen, in order
+    int nused[FAST_CTX]={};
+    for (int j=0; j<FAST_CTX && k; ++j)
+    {
+      memset(freq[j], 0, sizeof(freq[j]));
+      const U64 seen=GetVar(p, end);
+      for (U64 t=0, i=U64(-1); t<seen; ++t)
+      {
+        if ((i+=GetVar(p, end)+1)>=U64(FAST_SYMS))
+          Corrupt();
+        freq[j][i]=U32(GetVar(p, end));
+      }
+
+      U32 c=0;
+      for (int i=0; i<FAST_SYMS; ++i)
+      {
+        if (freq[j][i]>RANS_M-c)
+          Corrupt();
+        start[j][i]=c;
+        if (freq[j][i])
+          used[j][nused[j]++]=U16(i);
+        for (U32 t=0; t<freq[j][i] && table; ++t)
+          sym[j*RANS_M+c+t]=U16(i);
+        c+=freq[j][i];
+      }
+      if (c!=RANS_M && c!=0)
+        Corrupt();
+      if (!c && table) // Unseen, no symbol may come
+        std::fill(&sym[j*RANS_M], &sym[j*RANS_M]+RANS_M, U16(FAST_SYMS));
+    }
+    if (k && end-p<8)
+      Corrupt();
+
+    U32 st[2]={0, 0};
+    for (int j=0; j<2 && k; ++j, p+=4)
+      st[j]=p[0]|(p[1]<<8)|(p[2]<<16)|(U32(p[3])<<24);
+
+    U8 mtf[256];
+    for (int i=0; i<256; ++i)
+      mtf[i]=U8(i);
+
+    S64 i=0;
+    S64 run=0;
+    int bit=0;
+    int c=0;
+    for (S64 j=0; j<=k; ++j)
+    {
+      if (j<k)
+      {
+        U32& x=st[j&1];
+        const int t=Ctx(c);
+        if (table)
+          c=sym[t*RANS_M+(x&(RANS_M-1))];
+        else if (nused[t])
+        {
+          int lo=0;
+          for (int hi=nused[t]; hi-lo>1;)
+          {
+            const int mid=(lo+hi)/2;
+            if (start[t][used[t][mid]]<=(x&(RANS_M-1)))
+              lo=mid;
+            else
+              hi=mid;
+          }
+          c=used[t][lo];
+        }
+        else
+          c=FAST_SYMS;
+        if (c==FAST_SYMS)
+          Corrupt();
+        x=freq[t][c]*(x>>RANS_BITS)+(x&(RANS_M-1))-start[t][c];
+        while (x<RANS_L)
+          x=(x<<8)|(p<end?*p++:0);
+
+        if (c<2)
+        {
+          if (bit>40)
+            Corrupt();
+          run+=S64(c+1)<<bit++;
+          continue;
+        }
+      }
+      else
+        c=0;
+
+      if (run)
+      {
+        if (run>n-i)
+          Corrupt();
+        memset(&dst[i], mtf[0], size_t(run));
+        i+=run;
+        run=0;
+        bit=0;
+      }
+      if (c)
+      {
+        if (i>=n)
+          Corrupt();
+        const int r=c-1;
+        const U8 b=mtf[r];
+        memmove(&mtf[1], &mtf[0], r);
+        mtf[0]=b;
+        dst[i++]=b;
+      }
+    }
+    if (i!=n)
+      Corrupt();
+  }
+};
+
+// Parallel streams (-s) - the BWT output of a block is cut into up to K
+// contiguous parts of 1 MB or more, each coded by a model of its own, so
+// the CM stage of one big block runs on K threads. Such a stream has no
+// stream-wide CM; each block is varints for the size (0 - EOF), the BWT
+// index, U32 CRC32, U8 coder if the header says so, U8 parts, varint
+// length of each part and the parts
+
+const S64 PART_MIN=1<<20;
+
+int Parts(S64 n, int most)
+{
+  const S64 k=n/PART_MIN;
+  return int(k<1?1:(k<most?k:most));
+}
+
+struct Part
+{
+  std::vector<U8> mem;
+  std::atomic<int> done;
+};
+
+template<typename P>
+void EncodeCM(const U8* buf, S64 from, S64 to, std::vector<U8>& mem)
+{
+  Model<P>* cm=new Model<P>(nullptr, nullptr);
+  if (dict.snap)
+    cm->Prime(dict.snap);
+  cm->mem=&mem;
+
+  for (S64 i=from; i<to; ++i)
+    cm->Put(buf[i]);
+  cm->Flush();
+
+  delete cm;
+}
+
+void EncodePart(const U8* buf, S64 from, S64 to, int how, Part* part)
+{
+  switch (how)
+  {
+  case CODER_FAST:
+    Fast::Encode(&buf[from], to-from, part->mem);
+    break;
+  case CODER_QUICK:
+    EncodeCM<Quick>(buf, from, to, part->mem);
+    break;
+  case CODER_STEADY:
+    EncodeCM<Steady>(buf, from, to, part->mem);
+    break;
+  default:
+    EncodeCM<Balanced>(buf, from, to, part->mem);
+  }
+}
+
+// Model selection (-x) - TRIAL_CUTS slices of a block's BWT output, evenly
+// spaced and TRIAL bytes in all, are coded by each model in turn. Only the
+// second half of each slice is counted, the first warms the model up. The
+// block is coded by another model than Balanced only if it gave at least
+// 1% less, as the differences on big blocks are mostly noise
+
+const S64 TRIAL=1<<18;
+const int TRIAL_CUTS=4;
+
+template<typename P>
+size_t TrialCM(const U8* buf, S64 n)
+{
+  Model<P>* cm=new Model<P>(nullptr, nullptr);
+  if (dict.snap)
+    cm->Prime(dict.snap);
+  std::vector<U8> mem;
+  cm->mem=&mem;
+
+  const S64 w=(n<TRIAL)?n/TRIAL_CUTS:TRIAL/TRIAL_CUTS;
+  size_t size=0;
+  for (int i=0; i<TRIAL_CUTS; ++i)
+  {
+    const S64 from=(n-w)*i/(TRIAL_CUTS-1);
+    for (S64 j=from; j<from+w/2; ++j)
+      cm->Put(buf[j]);
+    const size_t warm=mem.size();
+    for (S64 j=from+w/2; j<from+w; ++j)
+      cm->Put(buf[j]);
+    size+=mem.size()-warm;
+  }
+
+  delete cm;
+  return size;
+}
+
+int Trial(const U8* buf, S64 n)
+{
+  const size_t size[3]={TrialCM<Balanced>(buf, n), TrialCM<Quick>(buf, n),
+      TrialCM<Steady>(buf, n)};
+
+  int best=CODER_CM;
+  size_t least=size[0]-size[0]/100;
+  if (size[1]<least)
+  {
+    best=CODER_QUICK;
+    least=size[1];
+  }
+  if (size[2]<least)
+    best=CODER_STEADY;
+
+  return best;
+}
+
+// how - the coder, recorded if HDR_CODER is set
+
+void EncodeParts(const Block* b, int most, int how, int flags, FILE* out)
+{
+  const S64 n=b->n;
+  const int k=Parts(n, most);
+
+  Part* part=new Part[k];
+  for (int j=0; j<k; ++j)
+  {
+    part[j].mem.reserve(size_t(n/k/3));
+    pool.Spawn(part[j].done, std::bind(EncodePart, b->buf, n*j/k, n*(j+1)/k, how, &part[j]));
+  }
+  for (int j=0; j<k; ++j)
+    pool.Wait(part[j].done);
+
+  PutVar(out, n);
+  PutVar(out, b->idx);
+  PutLE(out, b->crc, 4);
+  if (flags&HDR_CODER)
+    putc(how, out);
+  putc(k, out);
+  for (int j=0; j<k; ++j)
+    PutVar(out, part[j].mem.size());
+  for (int j=0; j<k; ++j)
+  {
+    if (fwrite(&part[j].mem[0], 1, part[j].mem.size(), out)!=part[j].mem.size())
+    {
+      perror("Fwrite() failed");
+      exit(1);
+    }
+  }
+
+  delete[] part;
+}
+
+const int btab[10]= // Block size of each level
+{
+  0,
+  1<<20,      // -1 - 1 MB
+  1<<22,      // -2 - 4 MB
+  1<<23,      // -3 - 8 MB
+  0x00FFFFFF, // -4 - ~16 MB (Default)
+  1<<25,      // -5 - 32 MB
+  1<<26,      // -6 - 64 MB
+  1<<27,      // -7 - 128 MB
+  1<<28,      // -8 - 256 MB
+  0x7FFFFFFF, // -9 - ~2 GB
+};
+
+// Throughput governor (--target-rate) - after each block, the sort and
+// coding times give the rate the compressor keeps up with. Below the target
+// the next blocks are coded in more parts (as long as there are threads
+// for them), then made smaller, down to 1 MB; well above it, the other
+// way round. Every block says its own size and parts, so the decoder needs
+// nothing more
+
+struct Governor
+{
+  S64 most; // Block size
+  S64 bs;
+  int parts;
+
+  void Init(S64 size)
+  {
+    most=bs=size;
+    parts=streams;
+  }
+
+  void Update(S64 n, double secs)
+  {
+    if (secs<=0) // Too quick to tell
+      return;
+
+    const double r=n/secs/1e6;
+    if (r<rate)
+    {
+      if (parts<pool.n && Parts(n, parts+1)>parts)
+        ++parts;
+      else if (bs>PART_MIN)
+        bs=(bs/2>PART_MIN)?bs/2:PART_MIN;
+    }
+    else if (r>rate*1.5)
+    {
+      if (bs<most)
+        bs=(bs*2<most)?bs*2:most;
+      else if (parts>streams)
+        --parts;
+    }
+  }
+};
+
+// Returns the size of the input, which may be a pipe. plain - no --ref,
+// as for the literals of a "BCMr" stream
+
+S64 Compress(FILE* in, FILE* out, int plain=0)
+{
+  if (rname && !plain)
+    return CompressRef(in, out);
+  if (dedup && !plain)
+    return CompressDedup(in, out);
+
+  S64 bs=bsize?bsize:btab[level]; // Block size
+
+  S64 flen=-1; // Not known for a pipe
+  if (!_fseeki64(in, 0, SEEK_END))
+  {
+    if ((flen=_ftelli64(in))<0)
+    {
+      perror("Ftell() failed");
+      exit(1);
+    }
+
+    // --part k/N codes the k-th of N byte ranges as a member of its own
+
+    S64 from=0;
+    if (nparts)
+    {
+      from=flen*(part-1)/nparts;
+      flen=flen*part/nparts-from;
+    }
+    _fseeki64(in, from, SEEK_SET);
+  }
+  else if (nparts)
+  {
+    fprintf(stderr, "--part needs a file, not a pipe\n");
+    exit(1);
+  }
+
+  if (flen>=0 && flen<=SMALL && flen<=bs)
+  {
+    CompressSmall(in, out, int(flen));
+    return flen;
+  }
+
+  putc(magic[0], out);
+  putc(magic[1], out);
+  putc(magic[2], out);
+  putc(magic[3], out);
+
+  const int more=(flen<0 || flen>bs); // Blocks
+
+  if (flen>=0 && bs>flen)
+    bs=flen;
+
+  const int wide=(bs>0x7FFFFFFF);
+  const int depth=more?Depth(bs*(wide?9:5)):1;
+
+  Header h;
+  h.ver=3;
+  h.level=bsize?0:level;
+  h.flags=adaptive?HDR_ADAPTIVE:0;
+  h.bsize=bs;
+  h.size=flen;
+  h.table=0;
+  h.dict=dict.id;
+  if (dict.snap)
+    h.flags|=HDR_DICT;
+  if (streams>1 || rate>0 || coder!=CODER_CM || trial)
+    h.flags|=HDR_PARTS;
+  if (coder!=CODER_CM || trial)
+    h.flags|=HDR_CODER;
+
+  Governor gov;
+  gov.Init(bs);
+
+  const S64 start=_ftelli64(out);
+  WriteHeader(out, h);
+
+  std::vector<std::pair<S64, U32> > table;
+
+  Block blk[2];
+  for (int i=0; i<depth; ++i)
+  {
+    blk[i].buf=MemAlloc<U8>(bs, i);
+    blk[i].ptr=wide?nullptr:MemAlloc<int>(bs, i);
+    blk[i].ptr64=wide?MemAlloc<int64_t>(bs, i):nullptr;
+    blk[i].avail=0;
+    blk[i].n=0;
+  }
+
+  CM cm(in, out);
+  if (dict.snap)
+    cm.Prime(dict.snap);
+  AsyncIO rd;
+  rd.Open(in, 0);
+  S64 pos=0;
+
+  Block* cur=&blk[0];
+  Block* nxt=&blk[depth-1];
+
+  ReadBlock(*cur, *cur, rd, gov.bs, pos, flen);
+  if (cur->n>0)
+    pool.Spawn(cur->done, std::bind(SortBlock, cur), int(cur-blk));
+
+  while (cur->n>0)
+  {
+    if (depth>1)
+    {
+      ReadBlock(*nxt, *cur, rd, gov.bs, pos, flen);
+      if (nxt->n>0)
+        pool.Spawn(nxt->done, std::bind(SortBlock, nxt), int(nxt-blk));
+    }
+
+    pool.Wait(cur->done);
+
+    const std::chrono::steady_clock::time_point coding=std::chrono::steady_clock::now();
+    const S64 n=cur->n;
+    const S64 idx=cur->idx;
+    table.push_back(std::make_pair(n, cur->crc));
+    if (h.flags&HDR_PARTS)
+      EncodeParts(cur, gov.parts, cur->how, h.flags, out);
+    else if (n>0x7FFFFFFF) // 64-bit block size and BWT index
+    {
+      cm.Put32(U32(n>>32)|0x80000000);
+      cm.Put32(U32(n));
+      cm.Put32(U32(idx>>32));
+      cm.Put32(U32(idx));
+    }
+    else
+    {
+      cm.Put32(U32(n)); // Block size
+      cm.Put32(U32(idx)); // BWT index
+    }
+
+    if (!(h.flags&HDR_PARTS))
+    {
+      cm.Put32(cur->crc); // CRC32 of the block
+
+      const U8* buf=cur->buf;
+      for (S64 i=0; i<n; ++i)
+        cm.Put(buf[i]);
+    }
+
+    if (rate>0) // The stages overlap when there are two blocks
+    {
+      const double secs=std::chrono::duration<double>(std::chrono::steady_clock::now()-coding).count();
+      gov.Update(n, (depth>1)?(secs>cur->secs?secs:cur->secs):secs+cur->secs);
+    }
+
+    if (!batch)
+      fprintf(stderr, "%lld -> %lld\r", pos, S64(_ftelli64(out)));
+
+    if (depth>1)
+    {
+      Block* t=cur;
+      cur=nxt;
+      nxt=t;
+    }
+    else
+    {
+      ReadBlock(*cur, *cur, rd, gov.bs, pos, flen);
+      if (cur->n>0)
+        SortBlock(cur);
+    }
+  }
+
+  rd.Close();
+
+  if (h.flags&HDR_PARTS)
+    PutVar(out, 0); // EOF
+  else
+  {
+    cm.Put32(0); // EOF
+    cm.Flush();
+  }
+
+  // The block table, and the header again now that the sizes are final
+
+  h.size=pos;
+  h.table=_ftelli64(out)-(start-4); // From the magic
+  PutLE(out, table.size(), 8);
+  for (size_t i=0; i<table.size(); ++i)
+  {
+    PutLE(out, table[i].first, 8);
+    PutLE(out, table[i].second, 4);
+  }
+
+  if (_fseeki64(out, start, SEEK_SET))
+  {
+    perror("Fseek() failed");
+    exit(1);
+  }
+  WriteHeader(out, h);
+  _fseeki64(out, 0, SEEK_END);
+
+  for (int i=0; i<depth; ++i)
+  {
+    if (wide)
+      MemFree(blk[i].ptr64, bs);
+    else
+      MemFree(blk[i].ptr, bs);
+    MemFree(blk[i].buf, bs);
+  }
+
+  return pos;
+}
+
+// Inverse BW-transform, two symbols per hop
+// Rows are sorted by their first two symbols, so a row's bigram is found
+// from its bucket and ptr[] takes the walk two steps at a time
+// On big blocks the tables are built by slices of rows in parallel, each
+// slice starting from the counts of the slices before it
+
+const S64 SLICE_MIN=1<<20; // Rows
+
+template<typename I, typename W, bool PACKED>
+struct UnBWT
+{
+  U8* buf;
+  W* ptr;
+  I n;
+  I idx;
+
+  struct Slice
+  {
+    I from;
+    I to;
+    S64 cnt[256];
+    W* bkt;
+    std::atomic<int> done;
+  };
+
+  int L(I i) const // Last column, row i!=idx
+  {
+    i-=(i>idx);
+    return PACKED?U8(ptr[i]):buf[i];
+  }
+
+  void Put(I p, I i)
+  {
+    if (PACKED)
+      ptr[p-1]|=W(i)<<8;
+    else
+      ptr[p-1]=W(i);
+  }
+
+  I Next(I p) const
+  {
+    return PACKED?I(ptr[p-1]>>8):I(ptr[p-1]);
+  }
+
+  void Count(Slice* s)
+  {
+    memset(s->cnt, 0, sizeof(s->cnt));
+    for (I i=s->from; i<s->to; ++i)
+    {
+      if (i!=idx)
+        ++s->cnt[L(i)];
+    }
+  }
+
+  // Count the bigrams of the hops from the rows of s, or fill in the hops
+
+  void Hop(Slice* s, bool put)
+  {
+    S64 cnt[256];
+    memcpy(cnt, s->cnt, sizeof(cnt));
+    W* bkt=s->bkt;
+    if (!put)
+      memset(bkt, 0, 65536*sizeof(W));
+    for (I i=s->from; i<s->to; ++i)
+    {
+      if (i!=idx)
+      {
+        const int c=L(i);
+        const I p=I(++cnt[c]);
+        if (p!=idx)
+        {
+          if (put)
+            Put(bkt[(L(p)<<8)+c]++, i);
+          else
+            ++bkt[(L(p)<<8)+c];
+        }
+      }
+    }
+  }
+
+  void Build(S64* cnt, W* bkt, int k)
+  {
+    Slice* s=new Slice[k];
+    for (int j=0; j<k; ++j)
+    {
+      s[j].from=I((S64(n)+1)*j/k);
+      s[j].to=I((S64(n)+1)*(j+1)/k);
+      s[j].bkt=MemAlloc<W>(65536);
+      pool.Spawn(s[j].done, std::bind(&UnBWT::Count, this, &s[j]));
+    }
+    for (int j=0; j<k; ++j)
+      pool.Wait(s[j].done);
+
+    for (int c=0; c<256; ++c)
+    {
+      S64 sum=cnt[c];
+      for (int j=0; j<k; ++j)
+      {
+        const S64 t=s[j].cnt[c];
+        s[j].cnt[c]=sum;
+        sum+=t;
+      }
+    }
+
+    for (int j=0; j<k; ++j)
+      pool.Spawn(s[j].done, std::bind(&UnBWT::Hop, this, &s[j], false));
+    for (int j=0; j<k; ++j)
+      pool.Wait(s[j].done);
+
+    // Row 0 takes the first place in its bucket, as in Run()
+
+    W sum=1;
+    for (int b=0; b<65536; ++b)
+    {
+      if (b==(L(0)<<8))
+        ++sum;
+      for (int j=0; j<k; ++j)
+      {
+        const W t=s[j].bkt[b];
+        s[j].bkt[b]=sum;
+        sum+=t;
+      }
+      bkt[b]=sum;
+    }
+
+    for (int j=0; j<k; ++j)
+      pool.Spawn(s[j].done, std::bind(&UnBWT::Hop, this, &s[j], true));
+    for (int j=0; j<k; ++j)
+    {
+      pool.Wait(s[j].done);
+      MemFree(s[j].bkt, 65536);
+    }
+    delete[] s;
+  }
+
+  void Run(S64* cnt, AsyncIO* out, CRC& crc)
+  {
+    W* bkt=MemAlloc<W>(65536);
+    U16* fast=MemAlloc<U16>(65536);
+
+    S64 k=(S64(n)+1)/SLICE_MIN;
+    if (k>pool.n)
+      k=pool.n;
+    if (k>1)
+      Build(cnt, bkt, int(k));
+    else
+    {
+      memset(bkt, 0, 65536*sizeof(W));
+      ++bkt[L(0)<<8]; // The row starting with the last symbol and EOF
+      I i=1;
+      for (int c=0; c<256; ++c)
+      {
+        for (; i<=cnt[c+1]; ++i)
+        {
+          if (i!=idx)
+            ++bkt[(L(i)<<8)+c];
+        }
+      }
+
+      W sum=1;
+      for (int j=0; j<65536; ++j)
+      {
+        const W t=bkt[j];
+        bkt[j]=sum;
+        sum+=t;
+      }
+      ++bkt[L(0)<<8];
+
+      for (i=0; i<=n; ++i)
+      {
+        if (i!=idx)
+        {
+          const int c=L(i);
+          const I p=I(++cnt[c]);
+          if (p!=idx)
+            Put(bkt[(L(p)<<8)+c]++, i);
+        }
+      }
+    }
+
+    // Now bkt[] holds the bucket ends
+
+    int shift=0;
+    while ((n>>shift)>=65536)
+      ++shift;
+    for (int j=0, b=0; j<=int(n>>shift); ++j)
+    {
+      while (I(bkt[b])<=(I(j)<<shift))
+        ++b;
+      fast[j]=b;
+    }
+
+    I p=idx;
+    for (I i=1; i<n && p>0; i+=2) // A corrupt block may cut the walk short
+    {
+      int b=fast[p>>shift];
+      while (I(bkt[b])<=p)
+        ++b;
+      p=Next(p);
+
+      crc.Update(b>>8);
+      crc.Update(b&255);
+      if (out) // Null when testing
+      {
+        out->Put(b>>8);
+        out->Put(b&255);
+      }
+    }
+
+    if (n&1)
+    {
+      int b=fast[p>>shift];
+      while (I(bkt[b])<=p)
+        ++b;
+
+      crc.Update(b>>8);
+      if (out)
+        out->Put(b>>8);
+    }
+
+    MemFree(bkt, 65536);
+    MemFree(fast, 65536);
+  }
+};
+
+// Decompression overlaps the same way - while one block is being decoded,
+// the previous one is inverted and written by another thread
+
+struct Slot
+{
+  S64 size;
+  U8* buf;
+  U32* ptr;
+  U64* ptr64;
+  S64 n;
+  S64 idx;
+  S64 cnt[257];
+  U32 crc; // Stored CRC32 of the block
+  int bad;
+  int group; // Whose node holds the tables
+  std::atomic<int> done;
+
+  void Alloc(S64 n) // Adaptive blocks may grow
+  {
+    if (n<=size)
+      return;
+
+    Free();
+    if ((size=n)>0x7FFFFFFF) // 8*N
+      ptr64=MemAlloc<U64>(size, group);
+    else
+    {
+      if (size>=(1<<24)) // 5*N
+        buf=MemAlloc<U8>(size, group);
+      ptr=MemAlloc<U32>(size, group);
+    }
+  }
+
+  void Free()
+  {
+    if (buf)
+      MemFree(buf, size);
+    if (ptr)
+      MemFree(ptr, size);
+    if (ptr64)
+      MemFree(ptr64, size);
+    buf=nullptr;
+    ptr=nullptr;
+    ptr64=nullptr;
+  }
+};
+
+// Decode symbols of the block into the layout of the inverse BW-transform,
+// and count them
+
+template<typename M, typename T>
+void GetSymbols(M& cm, T* dst, S64 from, S64 to, S64* cnt)
+{
+  for (S64 i=from; i<to; ++i)
+    ++cnt[(dst[i]=T(cm.Get()))+1];
+}
+
+template<typename M>
+void GetSymbols(M& cm, Slot* sl, S64 from, S64 to, S64* cnt)
+{
+  if (sl->ptr64) // 8*N
+    GetSymbols(cm, sl->ptr64, from, to, cnt);
+  else if (sl->n>=(1<<24)) // 5*N
+    GetSymbols(cm, sl->buf, from, to, cnt);
+  else // 4*N
+    GetSymbols(cm, sl->ptr, from, to, cnt);
+}
+
+struct InPart
+{
+  std::vector<U8> mem;
+  S64 cnt[257];
+  std::atomic<int> done;
+};
+
+// Bytes decoded by Fast, to lay out as from CM
+
+struct Bytes
+{
+  const U8* p;
+
+  int Get()
+  {
+    return *p++;
+  }
+};
+
+template<typename P, typename D> // To a Slot, or plain bytes
+void DecodeCM(D* dst, S64 from, S64 to, const U8* src, const U8* end, S64* cnt)
+{
+  Model<P>* cm=new Model<P>(nullptr, nullptr);
+  if (dict.snap)
+    cm->Prime(dict.snap);
+  cm->src=src;
+  cm->end=end;
+
+  cm->Init();
+  GetSymbols(*cm, dst, from, to, cnt);
+
+  delete cm;
+}
+
+void DecodePart(Slot* sl, S64 from, S64 to, int how, InPart* part)
+{
+  static const U8 none=0;
+  const U8* src=part->mem.empty()?&none:&part->mem[0];
+  const U8* end=src+part->mem.size();
+  memset(part->cnt, 0, sizeof(part->cnt));
+
+  switch (how)
+  {
+  case CODER_FAST:
+    {
+      std::vector<U8> buf(size_t(to-from)+1);
+      Fast::Decode(src, end, &buf[0], to-from);
+      Bytes b={&buf[0]};
+      GetSymbols(b, sl, from, to, part->cnt);
+    }
+    break;
+  case CODER_QUICK:
+    DecodeCM<Quick>(sl, from, to, src, end, part->cnt);
+    break;
+  case CODER_STEADY:
+    DecodeCM<Steady>(sl, from, to, src, end, part->cnt);
+    break;
+  default:
+    DecodeCM<Balanced>(sl, from, to, src, end, part->cnt);
+  }
+}
+
+void DecodeParts(FILE* in, Slot* sl, int k, int how)
+{
+  InPart* part=new InPart[k];
+  U64 left=U64(sl->n)+(sl->n>>3)+1024; // Coded parts may be a bit bigger
+  for (int j=0; j<k; ++j)
+  {
+    const U64 len=GetVar(in);
+    if (len>left)
+    {
+      fprintf(stderr, "Corrupt input!\n");
+      exit(1);
+    }
+    left-=len;
+    part[j].mem.resize(size_t(len));
+  }
+  for (int j=0; j<k; ++j)
+  {
+    if (!part[j].mem.empty()
+        && fread(&part[j].mem[0], 1, part[j].mem.size(), in)!=part[j].mem.size())
+    {
+      fprintf(stderr, "Unexpected end of file!\n");
+      exit(1);
+    }
+  }
+
+  const S64 n=sl->n;
+  for (int j=0; j<k; ++j)
+    pool.Spawn(part[j].done, std::bind(DecodePart, sl, n*j/k, n*(j+1)/k, how, &part[j]));
+
+  memset(sl->cnt, 0, sizeof(sl->cnt));
+  for (int j=0; j<k; ++j)
+  {
+    pool.Wait(part[j].done);
+    for (int i=0; i<257; ++i)
+      sl->cnt[i]+=part[j].cnt[i];
+  }
+
+  delete[] part;
+}
+
+// Legacy streams have a single CRC over the whole file, given as crc
+
+void UnpackBlock(Slot* sl, AsyncIO* out, CRC* crc)
+{
+  CRC blk;
+  if (!crc)
+    crc=&blk;
+
+  if (sl->ptr64)
+  {
+    UnBWT<S64, U64, true> t={nullptr, sl->ptr64, sl->n, sl->idx};
+    t.Run(sl->cnt, out, *crc);
+  }
+  else if (sl->n>=(1<<24))
+  {
+    UnBWT<int, U32, false> t={sl->buf, sl->ptr, int(sl->n), int(sl->idx)};
+    t.Run(sl->cnt, out, *crc);
+  }
+  else
+  {
+    UnBWT<int, U32, true> t={nullptr, sl->ptr, int(sl->n), int(sl->idx)};
+    t.Run(sl->cnt, out, *crc);
+  }
+
+  sl->bad=(crc==&blk && blk()!=sl->crc);
+}
+
+void CheckBlock(const Slot* sl, S64 num)
+{
+  if (sl->bad)
+  {
+    fprintf(stderr, "CRC error in block %lld!\n", num);
+    exit(1);
+  }
+}
+
+// Decode a stream to out, or just check it if out is null, and return its
+// original size. v1.60 streams have no block CRCs, and before v3 the sizes
+// are known only as the blocks come
+
+S64 Decompress(FILE* in, FILE* out, const Header& h)
+{
+  if (h.flags&HDR_SMALL)
+    return DecompressSmall(in, out, h);
+  if (h.flags&HDR_REF)
+    return DecompressRef(in, out, h);
+  if (h.flags&HDR_DEDUP)
+    return DecompressDedup(in, out, h);
+
+  const S64 bs=h.bsize; // 0 - not known, as in old streams
+  const int more=(h.size<0 || h.size>bs); // Blocks
+  const int depth=more?Depth(bs>0x7FFFFFFF?bs*8:bs>=(1<<24)?bs*5:bs*4):1;
+
+  Slot slot[2];
+  for (int i=0; i<depth; ++i)
+  {
+    slot[i].size=0;
+    slot[i].buf=nullptr;
+    slot[i].ptr=nullptr;
+    slot[i].ptr64=nullptr;
+    slot[i].group=i;
+    if (h.bsize>0 && h.size>0)
+      slot[i].Alloc(h.bsize<h.size?h.bsize:h.size);
+  }
+
+#ifdef HAVE_FALLOCATE
+  if (out && h.size>0) // Reserve the space up front, if the fs can
+    posix_fallocate(fileno(out), _ftelli64(out), h.size);
+#endif
+
+  CM cm(in, out);
+  CRC crc;
+  AsyncIO wr;
+  if (out)
+    wr.Open(out, 1);
+
+  if (h.flags&HDR_DICT)
+  {
+    if (!dict.snap || dict.id!=h.dict)
+    {
+      fprintf(stderr, "Dictionary %08X is needed (-D)\n", h.dict);
+      exit(1);
+    }
+    cm.Prime(dict.snap);
+  }
+
+  if (!(h.flags&HDR_PARTS))
+    cm.Init();
+
+  Slot* prev=nullptr;
+  int k=0;
+  S64 pos=0;
+  S64 num=0;
+
+  for (;;)
+  {
+    S64 n;
+    S64 idx;
+    U32 bcrc=0;
+    int how=CODER_CM;
+    int parts=0;
+    if (h.flags&HDR_PARTS)
+    {
+      if ((n=S64(GetVar(in)))==0) // EOF
+        break;
+      idx=S64(GetVar(in));
+      bcrc=U32(GetLE(in, 4));
+      if ((h.flags&HDR_CODER) && ((how=getc(in))<0 || how>=CODERS))
+        idx=0;
+      if ((parts=getc(in))<1)
+        idx=0;
+    }
+    else
+    {
+      const U32 x=cm.Get32();
+      if (!x) // EOF
+        break;
+
+      n=x;
+      if (x&0x80000000) // 64-bit block
+      {
+        n=(S64(x&0x7FFFFFFF)<<32)+cm.Get32();
+        idx=S64(cm.Get32())<<32;
+        idx+=cm.Get32();
+      }
+      else
+        idx=cm.Get32();
+
+      if (h.ver>1)
+        bcrc=cm.Get32();
+    }
+
+    if (idx<1 || idx>n || (h.bsize>0 && n>h.bsize))
+    {
+      fprintf(stderr, "Corrupt input!\n");
+      exit(1);
+    }
+
+    Slot* sl=&slot[k];
+    k=(k+1)%depth;
+    if (sl==prev) // One slot - its block must be written first
+    {
+      pool.Wait(prev->done);
+      CheckBlock(prev, num);
+      prev=nullptr;
+    }
+
+    sl->Alloc(n);
+    sl->n=n;
+    sl->idx=idx;
+    sl->crc=bcrc;
+
+    S64* cnt=sl->cnt;
+    if (parts)
+      DecodeParts(in, sl, parts, how);
+    else
+    {
+      memset(cnt, 0, sizeof(sl->cnt));
+      GetSymbols(cm, sl, 0, n, cnt);
+    }
+    for (int i=1; i<=256; ++i)
+      cnt[i]+=cnt[i-1];
+
+    if (prev) // Blocks are written in order
+    {
+      pool.Wait(prev->done);
+      CheckBlock(prev, num);
+    }
+
+    if (!batch)
+    {
+      if (h.size>0)
+        fprintf(stderr, "%lld -> %lld (%d%%)\r", S64(_ftelli64(in)), pos, int(pos*100/h.size));
+      else
+        fprintf(stderr, "%lld -> %lld\r", S64(_ftelli64(in)), pos);
+    }
+
+    pool.Spawn(sl->done, std::bind(UnpackBlock, sl, out?&wr:nullptr, (h.ver>1)?nullptr:&crc),
+        sl->group);
+    prev=sl;
+    pos+=n;
+    if (sl->done) // Run inline
+      CheckBlock(sl, ++num);
+    else
+      ++num;
+  }
+
+  if (prev)
+  {
+    pool.Wait(prev->done);
+    CheckBlock(prev, num);
+  }
+
+  if (out)
+  {
+    wr.Flush();
+    wr.Close();
+  }
+
+  if (h.ver==1 && cm.Get32()!=crc())
+  {
+    fprintf(stderr, "CRC error!\n");
+    exit(1);
+  }
+
+  if (h.size>=0 && pos!=h.size)
+  {
+    fprintf(stderr, "Size mismatch!\n");
+    exit(1);
+  }
+
+  for (int i=0; i<depth; ++i)
+    slot[i].Free();
+
+  return pos;
+}
+
+// Small inputs - one block and nothing set up per call: the buffers and
+// the model are kept per thread and the model is reset lazily. The stream
+// is the usual "BCM3" header with HDR_SMALL set and bsize = size, then a
+// varint BWT index, U32 CRC32 and the coded block - no block list and no
+// table. CompressBuffer() and DecompressBuffer() code it from and to
+// memory, for use as a library; bcm itself picks it for small files
+
+struct Arena
+{
+  U8* buf;
+  int* ptr;
+  CM* cm;
+
+  ~Arena()
+  {
+    if (cm)
+    {
+      delete cm;
+      MemFree(ptr, SMALL);
+      MemFree(buf, SMALL);
+    }
+  }
+
+  void Alloc()
+  {
+    if (!cm)
+    {
+      buf=MemAlloc<U8>(SMALL);
+      ptr=MemAlloc<int>(SMALL);
+      cm=new CM(nullptr, nullptr);
+    }
+  }
+
+  CM& Get()
+  {
+    Alloc();
+    cm->Start(nullptr, nullptr);
+    cm->Reset();
+    if (dict.snap)
+      cm->Prime(dict.snap);
+    return *cm;
+  }
+};
+
+thread_local Arena arena;
+
+void PutLE(std::vector<U8>& mem, U64 x, int n)
+{
+  for (int i=0; i<n; ++i)
+    mem.push_back(U8(x>>(i*8)));
+}
+
+U64 GetLE(const U8*& p, int n)
+{
+  U64 x=0;
+  for (int i=0; i<n; ++i)
+    x|=U64(*p++)<<(i*8);
+  return x;
+}
+
+// Codes the n bytes in arena.buf, overwriting them, to the end of mem
+
+void PackSmall(int n, std::vector<U8>& mem)
+{
+  for (int i=0; i<4; ++i)
+    mem.push_back(U8(magic[i]));
+  mem.push_back(U8(level));
+  mem.push_back(U8(HDR_SMALL|(dict.snap?HDR_DICT:0)));
+  PutLE(mem, n, 8);
+  PutLE(mem, n, 8);
+  PutLE(mem, 0, 8);
+  if (dict.snap)
+    PutLE(mem, dict.id, 4);
+  if (!n)
+    return;
+
+  CM& cm=arena.Get();
+  U8* buf=arena.buf;
+
+  CRC crc;
+  crc.Update(buf, n);
+
+  const int idx=libsais_bwt_ctx(sais.Get(0), buf, buf, arena.ptr, n, 0);
+  if (idx<1)
+  {
+    fprintf(stderr, "BWT() failed: idx = %d\n", idx);
+    exit(1);
+  }
+
+  Fast::PutVar(mem, U64(idx));
+  PutLE(mem, crc(), 4);
+
+  cm.mem=&mem;
+  for (int i=0; i<n; ++i)
+    cm.Put(buf[i]);
+  cm.Flush();
+}
+
+// Decodes n bytes to arena.buf from cm, set up to read the block. Returns
+// 0 if they are corrupt
+
+int UnpackSmall(CM& cm, int n, int idx, U32 stored)
+{
+  U32* ptr=(U32*)arena.ptr;
+  U8* buf=arena.buf;
+
+  cm.Init();
+
+  // The plain 4*N inverse BW-transform, a block this small stays in cache
+
+  int cnt[257];
+  memset(cnt, 0, sizeof(cnt));
+  for (int i=0; i<n; ++i)
+    ++cnt[(ptr[i]=cm.Get())+1];
+  for (int i=1; i<256; ++i)
+    cnt[i]+=cnt[i-1];
+
+  for (int i=0; i<idx; ++i)
+    ptr[cnt[ptr[i]&255]++]|=i<<8;
+  for (int i=idx+1; i<=n; ++i)
+    ptr[cnt[ptr[i-1]&255]++]|=i<<8;
+
+  CRC crc;
+  int p=idx;
+  for (int i=0; i<n; ++i)
+  {
+    if (p<1) // Corrupt
+      break;
+    p=ptr[p-1]>>8;
+    buf[i]=U8(ptr[p-(p>=idx)]);
+  }
+  crc.Update(buf, n);
+
+  return crc()==stored;
+}
+
+void CompressSmall(FILE* in, FILE* out, int n)
+{
+  arena.Alloc();
+  if (int(fread(arena.buf, 1, n, in))!=n)
+  {
+    perror("Fread() failed");
+    exit(1);
+  }
+
+  std::vector<U8> mem;
+  PackSmall(n, mem);
+  if (fwrite(mem.data(), 1, mem.size(), out)!=mem.size())
+  {
+    perror("Fwrite() failed");
+    exit(1);
+  }
+}
+
+S64 DecompressSmall(FILE* in, FILE* out, const Header& h)
+{
+  const int n=int(h.size);
+  if (!n)
+    return 0;
+
+  const int idx=int(GetVar(in));
+  const U32 stored=U32(GetLE(in, 4));
+  if (idx<1 || idx>n)
+  {
+    fprintf(stderr, "Corrupt input!\n");
+    exit(1);
+  }
+
+  if ((h.flags&HDR_DICT) && (!dict.snap || dict.id!=h.dict))
+  {
+    fprintf(stderr, "Dictionary %08X is needed (-D)\n", h.dict);
+    exit(1);
+  }
+
+  CM& cm=arena.Get();
+  cm.in=in;
+  if (!UnpackSmall(cm, n, idx, stored))
+  {
+    fprintf(stderr, "CRC error in block 1!\n");
+    exit(1);
+  }
+
+  if (out && int(fwrite(arena.buf, 1, n, out))!=n)
+  {
+    perror("Fwrite() failed");
+    exit(1);
+  }
+
+  return n;
+}
+
+// Compresses n bytes at src to the end of dst. Returns the size of the
+// stream, or -1 if n is over SMALL - bigger inputs go to Compress()
+
+S64 CompressBuffer(const U8* src, S64 n, std::vector<U8>& dst)
+{
+  static const int once=(CRC::Init(), 1);
+  (void)once;
+
+  if (n<0 || n>SMALL)
+    return -1;
+
+  const size_t from=dst.size();
+  arena.Alloc();
+  memcpy(arena.buf, src, size_t(n));
+  PackSmall(int(n), dst);
+  return S64(dst.size()-from);
+}
+
+// Decompresses the stream of n bytes at src, made by CompressBuffer(), to
+// the end of dst. Returns the size of the data, or -1 if the stream is not
+// one of these, is corrupt or needs a dictionary that isn't loaded
+
+S64 DecompressBuffer(const U8* src, S64 n, std::vector<U8>& dst)
+{
+  static const int once=(CRC::Init(), 1);
+  (void)once;
+
+  const U8* end=src+n;
+  if (n<30 || memcmp(src, magic, 4))
+    return -1;
+  src+=5;
+  const int flags=*src++;
+  const S64 bsize=S64(GetLE(src, 8));
+  const S64 size=S64(GetLE(src, 8));
+  src+=8;
+  if (!(flags&HDR_SMALL) || size!=bsize || size<0 || size>SMALL)
+    return -1;
+  if (flags&HDR_DICT)
+  {
+    if (end-src<4 || !dict.snap || dict.id!=U32(GetLE(src, 4)))
+      return -1;
+  }
+  if (!size)
+    return 0;
+
+  S64 idx=0;
+  for (int i=0;; i+=7) // Varint, not Fast::GetVar(), which exits
+  {
+    if (src>=end || i>28)
+      return -1;
+    const int c=*src++;
+    idx|=S64(c&127)<<i;
+    if (c<128)
+      break;
+  }
+  if (idx<1 || idx>size || end-src<4)
+    return -1;
+  const U32 stored=U32(GetLE(src, 4));
+
+  CM& cm=arena.Get();
+  cm.src=src;
+  cm.end=end;
+  if (!UnpackSmall(cm, int(size), int(idx), stored))
+    return -1;
+
+  dst.insert(dst.end(), arena.buf, arena.buf+size);
+  return size;
+}
+
+// Delta coding (--ref) - the input is matched against a reference file
+// that the decoder has too. Runs of REF_MIN bytes or more that are found in
+// it become copies, and only the rest, the literals, is compressed. A
+// "BCMr" stream is U8 flags, U32 CRC32 and U64 size of the reference, U64
+// size and U32 CRC32 of the data, varint number of copies and, for each,
+// varints length of the literals before it, its length and zigzag offset
+// from where the copy before ended; then the literals as a stream of their
+// own. The reference is indexed by a hash of REF_WIN bytes at every
+// REF_WIN-th position, and any common run of REF_MIN bytes covers one. The
+// input is read through a Window, so it can be a pipe
+
+const int REF_WIN=32;
+const int REF_MIN=64;
+const U32 REF_MUL=0x01000193;
+
+struct Ref
+{
+  const U8* mem;
+  S64 n;
+  U32 crc;
+  U32* tab; // 1 + position/REF_WIN, 0 - empty
+  int bits;
+  U32 top; // REF_MUL^REF_WIN
+
+  static U32 Hash(const U8* p)
+  {
+    U32 h=0;
+    for (int i=0; i<REF_WIN; ++i)
+      h=h*REF_MUL+p[i];
+    return h;
+  }
+
+  U32* Slot(U32 h) const
+  {
+    return &tab[(h*0x9E3779B1)>>(32-bits)];
+  }
+
+  void Load(const char* name);
+  void Index();
+};
+
+Ref ref;
+
+// Maps a whole file read-only, or reads it where there's no mmap()
+
+const U8* MapFile(const char* name, S64& n)
+{
+  FILE* f=fopen(name, "rb");
+  if (!f)
+  {
+    perror(name);
+    exit(1);
+  }
+  _fseeki64(f, 0, SEEK_END);
+  n=_ftelli64(f);
+  rewind(f);
+
+#ifdef _MSC_VER
+  U8* mem=(U8*)malloc(size_t(n)+1);
+  if (!mem || fread(mem, 1, size_t(n), f)!=size_t(n))
+  {
+    perror(name);
+    exit(1);
+  }
+#else
+  const U8* mem=nullptr;
+  if (n>0)
+  {
+    void* p=mmap(nullptr, size_t(n), PROT_READ, MAP_SHARED, fileno(f), 0);
+    if (p==MAP_FAILED)
+    {
+      perror("Mmap() failed");
+      exit(1);
+    }
+    mem=(const U8*)p;
+  }
+#endif
+  fclose(f);
+  return mem;
+}
+
+void Ref::Load(const char* name)
+{
+  mem=MapFile(name, n);
+
+  CRC c;
+  c.Update(mem, size_t(n));
+  crc=c();
+  tab=nullptr;
+}
+
+void Ref::Index()
+{
+  const S64 k=n/REF_WIN;
+  for (bits=10; bits<31 && (S64(1)<<bits)<k; ++bits)
+    ;
+  tab=MemAlloc<U32>(size_t(1)<<bits);
+  memset(tab, 0, sizeof(U32)<<bits);
+
+  top=1;
+  for (int i=0; i<REF_WIN; ++i)
+    top*=REF_MUL;
+
+  for (S64 i=0; i<k && i<0xFFFFFFFF; ++i)
+  {
+    U32* t=Slot(Hash(&mem[i*REF_WIN]));
+    if (!*t) // The first one, copies tend to go forward
+      *t=U32(i+1);
+  }
+}
+
+FILE* TmpFile()
+{
+  FILE* f=tmpfile();
+  if (!f)
+  {
+    perror("Tmpfile() failed");
+    exit(1);
+  }
+  return f;
+}
+
+void CopyFile(FILE* in, FILE* out, S64 n, CRC* crc)
+{
+  U8 buf[1<<16];
+  while (n>0)
+  {
+    const int k=int(n<S64(sizeof(buf))?n:S64(sizeof(buf)));
+    if (int(fread(buf, 1, k, in))!=k)
+    {
+      fprintf(stderr, "Unexpected end of file!\n");
+      exit(1);
+    }
+    if (crc)
+      crc->Update(buf, k);
+    if (out && int(fwrite(buf, 1, k, out))!=k)
+    {
+      perror("Fwrite() failed");
+      exit(1);
+    }
+    n-=k;
+  }
+}
+
+// The input, file or pipe, read through a buffer of WIN_BUF bytes and
+// addressed by position in it. Have() slides the buffer so that it holds
+// from..to-1, dropping what is before from, and tells if to is past the
+// end. Every byte read goes through crc, n is the size at the end
+
+const int WIN_BUF=1<<22;
+
+struct Window
+{
+  FILE* in;
+  U8* buf;
+  S64 pos; // Of buf[0]
+  S64 len;
+  int eof;
+  CRC crc;
+
+  Window(FILE* f)
+  {
+    in=f;
+    buf=MemAlloc<U8>(WIN_BUF);
+    pos=0;
+    len=0;
+    eof=0;
+  }
+
+  ~Window()
+  {
+    Free();
+  }
+
+  void Free() // Before the literals are compressed
+  {
+    if (buf)
+      MemFree(buf, WIN_BUF);
+    buf=nullptr;
+  }
+
+  U8* At(S64 i)
+  {
+    return &buf[i-pos];
+  }
+
+  U8 operator[](S64 i) const
+  {
+    return buf[i-pos];
+  }
+
+  S64 Size() const // Once Have() says no
+  {
+    return pos+len;
+  }
+
+  int Have(S64 from, S64 to)
+  {
+    while (to>pos+len)
+    {
+      if (eof)
+        return 0;
+      len-=from-pos;
+      memmove(buf, &buf[from-pos], size_t(len));
+      pos=from;
+
+      const size_t want=size_t(WIN_BUF-len);
+      const size_t k=fread(&buf[len], 1, want, in);
+      if (ferror(in))
+      {
+        perror("Fread() failed");
+        exit(1);
+      }
+      crc.Update(&buf[len], k);
+      len+=S64(k);
+      eof=(k<want);
+    }
+    return 1;
+  }
+};
+
+// Copies and literals, shared by "BCMr" and "BCMu" - varint number of
+// copies, the copies, then the literals as a stream of their own. Both
+// files are closed
+
+void PutCopies(FILE* out, FILE* ops, S64 copies, FILE* lit)
+{
+  PutVar(out, copies);
+  const S64 len=_ftelli64(ops);
+  rewind(ops);
+  CopyFile(ops, out, len, nullptr);
+  fclose(ops);
+
+  rewind(lit);
+  Compress(lit, out, 1);
+  fclose(lit);
+}
+
+// Reads up to most copies to op, three each, and decodes the literals to
+// a temporary file, rewound, which is returned with their size in nlit
+
+FILE* GetCopies(FILE* in, S64 most, std::vector<S64>& op, S64& nlit)
+{
+  const S64 copies=S64(GetVar(in));
+  if (copies<0 || copies>most)
+  {
+    fprintf(stderr, "Corrupt input!\n");
+    exit(1);
+  }
+  for (S64 i=0; i<copies*3; ++i) // Not sized up front, copies may be corrupt
+    op.push_back(S64(GetVar(in)));
+
+  FILE* lit=TmpFile();
+  S64 base=_ftelli64(in);
+  Header lh;
+  if (!ReadHeader(in, lh) || (lh.flags&(HDR_REF|HDR_DEDUP)))
+  {
+    fprintf(stderr, "Corrupt input!\n");
+    exit(1);
+  }
+  nlit=Decompress(in, lit, lh);
+  NextMember(in, base, lh);
+  rewind(lit);
+  return lit;
+}
+
+// Writes the literals up to to, which start where the ones before stopped
+
+void PutLits(Window& w, S64& done, S64 to, S64& lits, FILE* lit)
+{
+  if (to<=done)
+    return;
+  if (S64(fwrite(w.At(done), 1, size_t(to-done), lit))!=to-done)
+  {
+    perror("Fwrite() failed");
+    exit(1);
+  }
+  lits+=to-done;
+  done=to;
+}
+
+S64 CompressRef(FILE* in, FILE* out)
+{
+  Window w(in);
+
+  FILE* lit=TmpFile();
+  FILE* ops=TmpFile();
+  S64 copies=0;
+  S64 done=0; // Literals up to here are out
+  S64 lits=0; // of them since the last copy
+  S64 end=0; // Where the last copy ended in the reference
+  S64 i=0;
+  U32 h=0;
+  int fresh=1; // h is for i
+  for (;;)
+  {
+    if (i-done>=WIN_BUF/2) // A long run of literals, keep the buffer for it
+      PutLits(w, done, i, lits, lit);
+    if (!w.Have(done, i+REF_WIN))
+      break;
+    if (fresh)
+    {
+      h=Ref::Hash(w.At(i));
+      fresh=0;
+    }
+
+    const U32 a=*ref.Slot(h);
+    if (a)
+    {
+      const S64 r=S64(a-1)*REF_WIN;
+      if (!memcmp(&ref.mem[r], w.At(i), REF_WIN))
+      {
+        S64 b=0; // Back
+        while (i-b>done && r-b>0 && w[i-b-1]==ref.mem[r-b-1])
+          ++b;
+        S64 e=REF_WIN; // and forth. Once it's a copy, the literals before
+        S64 keep=done; // it go out and what it covers needn't be kept
+        for (;; ++e)
+        {
+          if (b+e>=REF_MIN)
+          {
+            PutLits(w, done, i-b, lits, lit);
+            keep=i+e;
+          }
+          if (r+e>=ref.n || !w.Have(keep, i+e+1) || w[i+e]!=ref.mem[r+e])
+            break;
+        }
+
+        if (b+e>=REF_MIN)
+        {
+          const S64 d=(r-b)-end;
+          PutVar(ops, U64(lits));
+          PutVar(ops, U64(b+e));
+          PutVar(ops, (U64(d)<<1)^U64(d>>63));
+          ++copies;
+          lits=0;
+
+          end=r+e;
+          i+=e;
+          done=i;
+          fresh=1;
+          continue;
+        }
+      }
+    }
+
+    if (w.Have(done, i+REF_WIN+1))
+      h=h*REF_MUL+w[i+REF_WIN]-w[i]*ref.top;
+    ++i;
+  }
+  const S64 n=w.Size();
+  PutLits(w, done, n, lits, lit);
+  w.Free();
+
+  putc(magic[0], out);
+  putc(magic[1], out);
+  putc(magic[2], out);
+  putc('r', out);
+  putc(HDR_REF, out);
+  PutLE(out, ref.crc, 4);
+  PutLE(out, ref.n, 8);
+  PutLE(out, n, 8);
+  PutLE(out, w.crc(), 4);
+  PutCopies(out, ops, copies, lit);
+
+  return n;
+}
+
+S64 DecompressRef(FILE* in, FILE* out, const Header& h)
+{
+  if (!rname || ref.crc!=h.ref || ref.n!=h.rsize)
+  {
+    fprintf(stderr, "Reference of %lld bytes, CRC32 %08X, is needed (--ref)\n",
+        h.rsize, h.ref);
+    exit(1);
+  }
+
+  std::vector<S64> op;
+  S64 nlit;
+  FILE* lit=GetCopies(in, h.size/REF_MIN, op, nlit);
+  const S64 copies=S64(op.size()/3);
+
+  CRC crc;
+  S64 got=0;
+  S64 used=0; // Literals
+  S64 end=0;
+  for (S64 i=0; i<copies; ++i)
+  {
+    const S64 k=op[i*3];
+    const S64 len=op[i*3+1];
+    const S64 r=end+((op[i*3+2]>>1)^-(op[i*3+2]&1));
+    if (k<0 || k>nlit-used || len<REF_MIN || r<0 || r>ref.n-len)
+    {
+      fprintf(stderr, "Corrupt input!\n");
+      exit(1);
+    }
+
+    CopyFile(lit, out, k, &crc);
+    used+=k;
+    crc.Update(&ref.mem[r], size_t(len));
+    if (out && S64(fwrite(&ref.mem[r], 1, size_t(len), out))!=len)
+    {
+      perror("Fwrite() failed");
+      exit(1);
+    }
+    end=r+len;
+    got+=k+len;
+  }
+  CopyFile(lit, out, nlit-used, &crc);
+  got+=nlit-used;
+  fclose(lit);
+
+  if (got!=h.size || crc()!=h.crc)
+  {
+    fprintf(stderr, "CRC error!\n");
+    exit(1);
+  }
+  return got;
+}
+
+// Deduplication (--dedup) - the input is cut into chunks where a rolling
+// hash of the last 64 bytes hits a pattern, so that the same content is cut
+// the same way wherever it is. A chunk that was seen before, anywhere in
+// the file, becomes a copy of it from the literals, and only the chunks
+// seen first are compressed. A "BCMu" stream is U8 flags, U64 size and
+// U32 CRC32 of the data, then copies and literals as for "BCMr", but the
+// copies are from the literals. The input goes through a Window and a
+// chunk that hashes the same as one seen before is checked against the
+// literals already written, so it can be a pipe
+
+const int CHUNK_MIN=1<<11;
+const int CHUNK_BITS=13; // Average chunk size is CHUNK_MIN+(1<<CHUNK_BITS)
+const int CHUNK_MAX=1<<16;
+
+struct Chunker
+{
+  U64 gear[256];
+
+  Chunker()
+  {
+    U64 x=0x9E3779B97F4A7C15;
+    for (int i=0; i<256; ++i)
+    {
+      x^=x<<13;
+      x^=x>>7;
+      x^=x<<17;
+      gear[i]=x;
+    }
+  }
+
+  // Length of the chunk at p
+
+  S64 Cut(const U8* p, S64 n) const
+  {
+    if (n<=CHUNK_MIN)
+      return n;
+    if (n>CHUNK_MAX)
+      n=CHUNK_MAX;
+
+    U64 h=0;
+    for (S64 i=CHUNK_MIN-64; i<n; ++i)
+    {
+      h=(h<<1)+gear[p[i]];
+      if (i>=CHUNK_MIN && !(h>>(64-CHUNK_BITS)))
+        return i+1;
+    }
+    return n;
+  }
+};
+
+// Tells if the m bytes at p are at pos in the literals, which are written
+// up to nlit and left there
+
+int SameLit(FILE* lit, S64 pos, S64 nlit, const U8* p, S64 m, U8* tmp)
+{
+  _fseeki64(lit, pos, SEEK_SET);
+  const int ok=S64(fread(tmp, 1, size_t(m), lit))==m && !memcmp(tmp, p, size_t(m));
+  _fseeki64(lit, nlit, SEEK_SET);
+  return ok;
+}
+
+S64 CompressDedup(FILE* in, FILE* out)
+{
+  Window w(in);
+
+  struct Chunk
+  {
+    S64 lit; // Where it is in the literals
+    U32 len;
+    U32 crc;
+  };
+  std::vector<Chunk> chunk;
+
+  // 1 + index in chunk, 0 - empty, doubled when half full
+  std::vector<U32> tab(1024);
+  U32 mask=1023;
+
+  const Chunker cdc;
+  std::vector<U8> tmp(CHUNK_MAX);
+  FILE* lit=TmpFile();
+  FILE* ops=TmpFile();
+  S64 copies=0;
+  S64 nlit=0;
+  S64 run=0; // Literals since the last copy
+  S64 from=-1; // The copy that may yet grow
+  S64 len=0;
+  S64 end=0; // Where the copy before ended
+  for (S64 i=0; w.Have(i, i+1);)
+  {
+    w.Have(i, i+CHUNK_MAX); // Or up to the end
+    const S64 m=cdc.Cut(w.At(i), w.Size()-i);
+    CRC c;
+    c.Update(w.At(i), size_t(m));
+
+    U32 j=(c()*0x9E3779B1)&mask;
+    while (tab[j])
+    {
+      const Chunk& k=chunk[tab[j]-1];
+      if (k.crc==c() && k.len==m && SameLit(lit, k.lit, nlit, w.At(i), m, &tmp[0]))
+        break;
+      j=(j+1)&mask;
+    }
+    if (tab[j]) // Seen
+    {
+      const S64 r=chunk[tab[j]-1].lit;
+      if (len && from+len==r)
+        len+=m;
+      else
+      {
+        if (len) // Its literals are out already
+        {
+          PutVar(ops, U64(len));
+          PutVar(ops, (U64(from-end)<<1)^U64((from-end)>>63));
+          end=from+len;
+          ++copies;
+        }
+        PutVar(ops, U64(run));
+        run=0;
+        from=r;
+        len=m;
+      }
+    }
+    else
+    {
+      if (len)
+      {
+        PutVar(ops, U64(len));
+        PutVar(ops, (U64(from-end)<<1)^U64((from-end)>>63));
+        end=from+len;
+        ++copies;
+        len=0;
+      }
+      if (chunk.size()<0x7FFFFFFF)
+      {
+        tab[j]=U32(chunk.size()+1);
+        chunk.push_back({nlit, U32(m), c()});
+        if (chunk.size()*2>tab.size())
+        {
+          tab.assign(tab.size()*2, 0);
+          mask=U32(tab.size()-1);
+          for (size_t k=0; k<chunk.size(); ++k)
+          {
+            U32 t=(chunk[k].crc*0x9E3779B1)&mask;
+            while (tab[t])
+              t=(t+1)&mask;
+            tab[t]=U32(k+1);
+          }
+        }
+      }
+      if (S64(fwrite(w.At(i), 1, size_t(m), lit))!=m)
+      {
+        perror("Fwrite() failed");
+        exit(1);
+      }
+      nlit+=m;
+      run+=m;
+    }
+    i+=m;
+  }
+  if (len)
+  {
+    PutVar(ops, U64(len));
+    PutVar(ops, (U64(from-end)<<1)^U64((from-end)>>63));
+    ++copies;
+  }
+  const S64 n=w.Size();
+  w.Free();
+
+  putc(magic[0], out);
+  putc(magic[1], out);
+  putc(magic[2], out);
+  putc('u', out);
+  putc(HDR_DEDUP, out);
+  PutLE(out, n, 8);
+  PutLE(out, w.crc(), 4);
+  PutCopies(out, ops, copies, lit);
+
+  return n;
+}
+
+S64 DecompressDedup(FILE* in, FILE* out, const Header& h)
+{
+  std::vector<S64> op;
+  S64 nlit;
+  FILE* lit=GetCopies(in, h.size/CHUNK_MIN, op, nlit);
+  const S64 copies=S64(op.size()/3);
+
+  CRC crc;
+  S64 got=0;
+  S64 used=0; // Literals
+  S64 end=0;
+  for (S64 i=0; i<copies; ++i)
+  {
+    const S64 k=op[i*3];
+    const S64 len=op[i*3+1];
+    const S64 r=end+((op[i*3+2]>>1)^-(op[i*3+2]&1));
+    if (k<0 || k>nlit-used || len<1 || r<0 || r>used+k-len)
+    {
+      fprintf(stderr, "Corrupt input!\n");
+      exit(1);
+    }
+
+    CopyFile(lit, out, k, &crc);
+    used+=k;
+    _fseeki64(lit, r, SEEK_SET);
+    CopyFile(lit, out, len, &crc);
+    _fseeki64(lit, used, SEEK_SET);
+    end=r+len;
+    got+=k+len;
+  }
+  CopyFile(lit, out, nlit-used, &crc);
+  got+=nlit-used;
+  fclose(lit);
+
+  if (got!=h.size || crc()!=h.crc)
+  {
+    fprintf(stderr, "CRC error!\n");
+    exit(1);
+  }
+  return got;
+}
+
+void Dict::Load(const char* name)
+{
+  FILE* f=fopen(name, "rb");
+  if (!f)
+  {
+    perror(name);
+    exit(1);
+  }
+
+  U8 h[HEAD];
+  if (fread(h, 1, HEAD, f)!=HEAD || memcmp(h, "BCMD", 4) || h[4]!=1)
+  {
+    fprintf(stderr, "%s: Not a BCM dictionary\n", name);
+    exit(1);
+  }
+  id=h[8]|(h[9]<<8)|(h[10]<<16)|(U32(h[11])<<24);
+
+  _fseeki64(f, 0, SEEK_END);
+  len=size_t(_ftelli64(f));
+  if (len!=HEAD+SIZE)
+  {
+    fprintf(stderr, "%s: Corrupt dictionary\n", name);
+    exit(1);
+  }
+
+#ifdef _MSC_VER
+  mem=(U8*)malloc(len);
+  rewind(f);
+  if (!mem || fread(mem, 1, len, f)!=len)
+  {
+    perror(name);
+    exit(1);
+  }
+#else
+  void* p=mmap(nullptr, len, PROT_READ, MAP_SHARED, fileno(f), 0);
+  if (p==MAP_FAILED)
+  {
+    perror("Mmap() failed");
+    exit(1);
+  }
+  mem=(U8*)p;
+#endif
+  fclose(f);
+
+  snap=&mem[HEAD];
+
+  CRC crc;
+  crc.Update((U8*)snap, SIZE);
+  if (crc()!=id)
+  {
+    fprintf(stderr, "%s: Corrupt dictionary\n", name);
+    exit(1);
+  }
+}
+
+void Dict::Save(const CM& cm, const char* name)
+{
+  U8* buf=(U8*)malloc(SIZE);
+  if (!buf)
+  {
+    fprintf(stderr, "Out of memory!\n");
+    exit(1);
+  }
+  memcpy(buf, cm.counter0, sizeof(cm.counter0));
+  memcpy(&buf[sizeof(cm.counter0)], cm.counter1, sizeof(cm.counter1));
+  memcpy(&buf[sizeof(cm.counter0)+sizeof(cm.counter1)], cm.counter2, sizeof(cm.counter2));
+
+  CRC crc;
+  crc.Update(buf, SIZE);
+  id=crc();
+
+  FILE* f=fopen(name, "wb");
+  if (!f)
+  {
+    perror(name);
+    exit(1);
+  }
+  fwrite("BCMD", 1, 4, f);
+  PutLE(f, 1, 4); // Version
+  PutLE(f, id, 4);
+  PutLE(f, 0, 4);
+  if (fwrite(buf, 1, SIZE, f)!=SIZE || fclose(f))
+  {
+    perror(name);
+    exit(1);
+  }
+
+  free(buf);
+}
+
+// Train a dictionary - code the files, in blocks of 1 MB at most, as
+// small inputs would be, and keep the model it ends with
+
+void Train(const std::vector<std::string>& files, const char* name)
+{
+  const S64 bs=1<<20;
+  U8* buf=MemAlloc<U8>(bs);
+  int* ptr=MemAlloc<int>(bs);
+
+  FILE* tmp=tmpfile();
+  if (!tmp)
+  {
+    perror("Tmpfile() failed");
+    exit(1);
+  }
+  CM cm(nullptr, tmp);
+
+  S64 total=0;
+  for (size_t i=0; i<files.size(); ++i)
+  {
+    FILE* in=fopen(files[i].c_str(), "rb");
+    if (!in)
+    {
+      perror(files[i].c_str());
+      exit(1);
+    }
+
+    int n;
+    while ((n=int(fread(buf, 1, bs, in)))>0)
+    {
+      if (libsais_bwt_ctx(sais.Get(0), buf, buf, ptr, n, 0)<1)
+      {
+        fprintf(stderr, "BWT() failed\n");
+        exit(1);
+      }
+      for (int j=0; j<n; ++j)
+        cm.Put(buf[j]);
+      total+=n;
+    }
+    fclose(in);
+  }
+  cm.Flush();
+
+  dict.Save(cm, name);
+  fprintf(stderr, "%d files, %lld -> %lld, dictionary %08X written to '%s'\n",
+      int(files.size()), total, S64(_ftelli64(tmp)), dict.id, name);
+
+  fclose(tmp);
+  MemFree(ptr, bs);
+  MemFree(buf, bs);
+}
+
+// Skip what follows a decoded member, its block table, and return whether
+// another one follows, at base. Older streams are the whole file
+
+int NextMember(FILE* in, S64& base, const Header& h)
+{
+  if (h.ver<3)
+  {
+    _fseeki64(in, 0, SEEK_END);
+    return 0;
+  }
+
+  if (h.table>0)
+  {
+    if (_fseeki64(in, base+h.table, SEEK_SET))
+    {
+      perror("Fseek() failed");
+      exit(1);
+    }
+    const S64 blocks=S64(GetLE(in, 8));
+    if (blocks<0 || _fseeki64(in, blocks*12, SEEK_CUR))
+    {
+      fprintf(stderr, "Corrupt input!\n");
+      exit(1);
+    }
+  }
+
+  base=_ftelli64(in);
+  const int c=getc(in);
+  if (c==EOF)
+    return 0;
+  ungetc(c, in);
+  return 1;
+}
+
+// Decodes every member of a file, with the header of the first in h, and
+// returns the size of the output
+
+S64 DecompressAll(FILE* in, FILE* out, Header& h, const char* ifname)
+{
+  S64 size=0;
+  for (S64 base=0;;) // Each member
+  {
+    size+=Decompress(in, out, h);
+    if (!NextMember(in, base, h))
+      break;
+    if (!ReadHeader(in, h))
+    {
+      fprintf(stderr, "%s: Garbage after the stream\n", ifname);
+      exit(1);
+    }
+  }
+  return size;
+}
+
+// Daemon (--daemon socket) - a master process listens on a Unix socket and
+// forks --jobs workers that take connections in turn, each one job at a
+// time, with its thread pool, libsais contexts, small-input arena and big
+// tables (see Stash) kept warm across jobs. A worker that fails on a job
+// exits as ever and the master forks another. Connections wait in the
+// listen queue, --queue deep. A client (--via socket) opens the files and
+// sends a request with their descriptors and its stderr:
+//   U8 mode ('c', 'd' or 't'), U8 level, U8 flags (1 - -a, 2 - -x,
+//   4 - --dedup), U8 coder, U8 streams, U64 block size (-b)
+// and gets U8 status (0 - done), U64 input size and U64 output size.
+// Every other option is reset for each job, but those that name files
+// (-D, --ref) and --target-rate, which are the daemon's own. The socket is
+// made with mode 0600, for its owner only
+
+#ifdef HAVE_DAEMON
+const int REQUEST=13;
+const int REPLY=17;
+
+int Connect(const char* name, int serve)
+{
+  const int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un a;
+  memset(&a, 0, sizeof(a));
+  a.sun_family=AF_UNIX;
+  if (fd<0 || strlen(name)>=sizeof(a.sun_path))
+  {
+    fprintf(stderr, "%s: Bad socket\n", name);
+    exit(1);
+  }
+  strcpy(a.sun_path, name);
+
+  if (serve)
+  {
+    struct stat sb;
+    if (!stat(name, &sb) && S_ISSOCK(sb.st_mode)) // Left by a daemon before
+      unlink(name);
+    const mode_t mask=umask(0177);
+    const int err=bind(fd, (struct sockaddr*)&a, sizeof(a));
+    umask(mask);
+    if (err || listen(fd, queue))
+    {
+      perror(name);
+      exit(1);
+    }
+  }
+  else if (connect(fd, (struct sockaddr*)&a, sizeof(a)))
+  {
+    perror(name);
+    exit(1);
+  }
+  return fd;
+}
+
+S64 Remote(FILE* in, FILE* out, S64& isize)
+{
+  if (out)
+    fflush(out);
+
+  U8 req[REQUEST];
+  req[0]=U8(test?'t':decompress?'d':'c');
+  req[1]=U8(level);
+  req[2]=U8(adaptive|(trial<<1)|(dedup<<2));
+  req[3]=U8(coder);
+  req[4]=U8(streams);
+  for (int i=0; i<8; ++i)
+    req[5+i]=U8(U64(bsize)>>(i*8));
+
+  int fd[3]={fileno(in), out?fileno(out):-1, 2};
+  const int k=out?3:2;
+  if (!out)
+    fd[1]=2;
+
+  struct iovec iov={req, sizeof(req)};
+  char buf[CMSG_SPACE(sizeof(fd))];
+  memset(buf, 0, sizeof(buf));
+  struct msghdr m;
+  memset(&m, 0, sizeof(m));
+  m.msg_iov=&iov;
+  m.msg_iovlen=1;
+  m.msg_control=buf;
+  m.msg_controllen=CMSG_SPACE(sizeof(int)*k);
+  struct cmsghdr* c=CMSG_FIRSTHDR(&m);
+  c->cmsg_level=SOL_SOCKET;
+  c->cmsg_type=SCM_RIGHTS;
+  c->cmsg_len=CMSG_LEN(sizeof(int)*k);
+  memcpy(CMSG_DATA(c), fd, sizeof(int)*k);
+
+  const int sock=Connect(via, 0);
+  if (sendmsg(sock, &m, 0)!=REQUEST)
+  {
+    perror("Sendmsg() failed");
+    exit(1);
+  }
+
+  U8 rep[REPLY];
+  int got=0;
+  for (int r; got<REPLY && (r=int(read(sock, &rep[got], REPLY-got)))>0;)
+    got+=r;
+  close(sock);
+  if (got<REPLY || rep[0])
+  {
+    fprintf(stderr, "The daemon failed on the job\n");
+    exit(1);
+  }
+
+  isize=0;
+  S64 size=0;
+  for (int i=7; i>=0; --i)
+  {
+    isize=(isize<<8)|rep[1+i];
+    size=(size<<8)|rep[9+i];
+  }
+  return size;
+}
+
+void Serve(int sock)
+{
+  U8 req[REQUEST];
+  int fd[3]={-1, -1, -1};
+  struct iovec iov={req, sizeof(req)};
+  char buf[CMSG_SPACE(sizeof(fd))];
+  struct msghdr m;
+  memset(&m, 0, sizeof(m));
+  m.msg_iov=&iov;
+  m.msg_iovlen=1;
+  m.msg_control=buf;
+  m.msg_controllen=sizeof(buf);
+  const int got=int(recvmsg(sock, &m, 0));
+  int n=0; // Descriptors in fd[]
+  for (struct cmsghdr* c=CMSG_FIRSTHDR(&m); got>=0 && c; c=CMSG_NXTHDR(&m, c))
+  {
+    if (c->cmsg_level!=SOL_SOCKET || c->cmsg_type!=SCM_RIGHTS)
+      continue;
+    const int* p=(const int*)CMSG_DATA(c);
+    for (int i=0; i<int((c->cmsg_len-CMSG_LEN(0))/sizeof(int)); ++i)
+    {
+      int x;
+      memcpy(&x, &p[i], sizeof(x));
+      if (n<3)
+        fd[n++]=x;
+      else
+        close(x); // More than a job takes
+    }
+  }
+
+  const int mode=req[0];
+  const int k=(mode=='t')?2:3;
+  if (got!=REQUEST || (m.msg_flags&MSG_CTRUNC) || n!=k
+      || (mode!='c' && mode!='d' && mode!='t') || req[1]>9
+      || req[2]>7 || req[3]>=CODERS || !req[4])
+  {
+    for (int i=0; i<3; ++i)
+    {
+      if (fd[i]>=0)
+        close(fd[i]);
+    }
+    return;
+  }
+
+  level=req[1];
+  adaptive=req[2]&1;
+  trial=(req[2]>>1)&1;
+  dedup=(req[2]>>2)&1;
+  coder=req[3];
+  streams=req[4];
+  bsize=0;
+  for (int i=7; i>=0; --i)
+    bsize=(bsize<<8)|req[5+i];
+  decompress=(mode!='c');
+  test=(mode=='t');
+  list=0; // Nothing from the daemon's command line
+  estimate=0;
+  train=0;
+  fmindex=0;
+  pattern=nullptr;
+  count=0;
+  part=0;
+  nparts=0;
+
+  const int err=dup(2); // Messages go to the client
+  dup2(fd[k-1], 2);
+  close(fd[k-1]);
+
+  FILE* in=fdopen(fd[0], "rb");
+  FILE* out=(k==3)?fdopen(fd[1], "wb"):nullptr;
+  if (!in || (k==3 && !out))
+  {
+    perror("Fdopen() failed");
+    exit(1);
+  }
+  _fseeki64(in, 0, SEEK_SET);
+
+  S64 isize;
+  S64 size;
+  if (decompress)
+  {
+    Header h;
+    if (!ReadHeader(in, h))
+    {
+      fprintf(stderr, "Not in BCM format\n");
+      exit(1);
+    }
+    size=DecompressAll(in, out, h, "input");
+    isize=_ftelli64(in);
+  }
+  else
+  {
+    isize=Compress(in, out);
+    size=_ftelli64(out);
+  }
+
+  fclose(in);
+  if (out && fclose(out))
+  {
+    perror("Fclose() failed");
+    exit(1);
+  }
+  fflush(stderr);
+  dup2(err, 2);
+  close(err);
+
+  U8 rep[REPLY]={0};
+  for (int i=0; i<8; ++i)
+  {
+    rep[1+i]=U8(U64(isize)>>(i*8));
+    rep[9+i]=U8(U64(size)>>(i*8));
+  }
+  if (write(sock, rep, REPLY)!=REPLY)
+    perror("Write() failed");
+}
+
+// Faults in the tables of a job at the daemon's level, so the first job
+// finds them warm too
+
+void Warm()
+{
+  const S64 bs=bsize?bsize:btab[level];
+  if (bs>0x7FFFFFFF)
+    return;
+
+  for (int i=0; i<2; ++i)
+  {
+    U8* buf=MemAlloc<U8>(bs);
+    int* ptr=MemAlloc<int>(bs);
+    memset(buf, 0, bs);
+    memset(ptr, 0, sizeof(int)*bs);
+    MemFree(buf, bs);
+    MemFree(ptr, bs);
+  }
+}
+
+volatile sig_atomic_t stop=0;
+
+void Stop(int)
+{
+  stop=1;
+}
+
+void Daemon()
+{
+  const int sock=Connect(sname, 1);
+  batch=1;
+
+  std::vector<pid_t> pid(jobs, 0);
+  struct sigaction sa; // No SA_RESTART, so that wait() returns
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler=Stop;
+  sigaction(SIGTERM, &sa, nullptr);
+  sigaction(SIGINT, &sa, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "Listening on '%s', %d worker%s\n", sname, jobs, jobs>1?"s":"");
+
+  while (!stop)
+  {
+    for (int i=0; i<jobs; ++i)
+    {
+      if (pid[i]>0)
+        continue;
+      if ((pid[i]=fork())<0)
+      {
+        perror("Fork() failed");
+        exit(1);
+      }
+      if (!pid[i]) // A worker
+      {
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        pool.Start(threads);
+#ifdef HAVE_HUGEPAGES
+        stash.most=8;
+        Warm();
+#endif
+        for (;;)
+        {
+          const int c=accept(sock, nullptr, nullptr);
+          if (c<0)
+          {
+            if (errno==EINTR || errno==ECONNABORTED)
+              continue;
+            perror("Accept() failed");
+            _exit(1);
+          }
+          Serve(c);
+          close(c);
+        }
+      }
+    }
+
+    const pid_t p=wait(nullptr); // Fork again for one that died
+    for (int i=0; i<jobs; ++i)
+    {
+      if (pid[i]==p)
+        pid[i]=0;
+    }
+  }
+
+  for (int i=0; i<jobs; ++i)
+  {
+    if (pid[i]>0)
+      kill(pid[i], SIGTERM);
+  }
+  while (wait(nullptr)>0)
+    ;
+  close(sock);
+  unlink(sname);
+}
+#else
+S64 Remote(FILE*, FILE*, S64&)
+{
+  fprintf(stderr, "--via is not supported on this system\n");
+  exit(1);
+}
+
+void Daemon()
+{
+  fprintf(stderr, "--daemon is not supported on this system\n");
+  exit(1);
+}
+#endif
+
+void ProcessFile(const char* ifname, const char* ofname)
+{
+  const std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+
+  FILE* in=fopen(ifname, "rb");
+  if (!in)
+  {
+    perror(ifname);
+    exit(1);
+  }
+
+  if (!overwrite && !test)
+  {
+    FILE* f=fopen(ofname, "rb");
+    if (f)
+    {
+      fclose(f);
+
+      if (batch)
+      {
+        fprintf(stderr, "%s: File '%s' already exists, skipped\n", ifname, ofname);
+        fclose(in);
+        return;
+      }
+
+      fprintf(stderr, "File '%s' already exists. Overwrite (y/n)? ", ofname);
+      fflush(stderr);
+
+      if (getchar()!='y')
       {
         fprintf(stderr, "Not overwritten\n");
         exit(1);
@@ -589,69 +4641,1715 @@ int main(int argc, char** argv)
     }
   }
 
-  if (decompress)
+  FILE* out=nullptr;
+  S64 isize;
+  S64 size;
+  if (decompress)
+  {
+    Header h;
+    if (!ReadHeader(in, h))
+    {
+      fprintf(stderr, "%s: Not in BCM format\n", ifname);
+      exit(1);
+    }
+
+    if (!test)
+    {
+      out=fopen(ofname, "wb");
+      if (!out)
+      {
+        perror(ofname);
+        exit(1);
+      }
+    }
+
+    if (!batch)
+      fprintf(stderr, "%s '%s':\n", test?"Testing":"Decompressing", ifname);
+
+    if (via)
+      size=Remote(in, out, isize);
+    else
+    {
+      size=DecompressAll(in, out, h, ifname);
+      isize=_ftelli64(in);
+    }
+  }
+  else
+  {
+    out=fopen(ofname, "wb");
+    if (!out)
+    {
+      perror(ofname);
+      exit(1);
+    }
+
+    if (!batch)
+      fprintf(stderr, "Compressing '%s':\n", ifname);
+
+    if (via)
+      size=Remote(in, out, isize);
+    else
+    {
+      isize=Compress(in, out);
+      size=_ftelli64(out);
+    }
+  }
+
+  if (batch)
+    fprintf(stderr, "%s: %lld -> %lld%s\n",
+        ifname, isize, size, test?" ok":"");
+  else
+    fprintf(stderr, "%lld -> %lld in %1.1f sec%s\n",
+        isize, size,
+        std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count(),
+        test?", ok":"");
+
+  fclose(in);
+  if (!out)
+    return;
+  fclose(out);
+
+#ifndef NO_UTIME
+  struct _stati64 sb;
+  if (_stati64(ifname, &sb))
+  {
+    perror("Stat() failed");
+    exit(1);
+  }
+  struct utimbuf ub;
+  ub.actime=sb.st_atime;
+  ub.modtime=sb.st_mtime;
+  if (utime(ofname, &ub))
+  {
+    perror("Utime() failed");
+    exit(1);
+  }
+#endif
+}
+
+// Print what the headers tell about a file, without decoding it. Small
+// members have no table to skip them by, so they are decoded
+
+void List(const char* ifname, S64* total)
+{
+  FILE* in=fopen(ifname, "rb");
+  if (!in)
+  {
+    perror(ifname);
+    exit(1);
+  }
+
+  Header h;
+  if (!ReadHeader(in, h))
+  {
+    fprintf(stderr, "%s: Not in BCM format\n", ifname);
+    exit(1);
+  }
+
+  int how=-1; // Of the first block
+  if (h.flags&HDR_CODER)
+  {
+    GetVar(in);
+    GetVar(in);
+    GetLE(in, 4);
+    how=getc(in);
+  }
+
+  const Header first=h;
+  S64 size=0;
+  S64 blocks=0;
+  int members=0;
+  for (S64 base=0;;)
+  {
+    ++members;
+    size=(size>=0 && h.size>=0)?size+h.size:-1;
+    if (h.flags&(HDR_REF|HDR_DEDUP)) // Skip the copies, the blocks are the literals
+    {
+      const S64 copies=S64(GetVar(in));
+      for (S64 i=0; i<copies*3; ++i)
+        GetVar(in);
+      base=_ftelli64(in);
+      if (!ReadHeader(in, h))
+      {
+        fprintf(stderr, "%s: Corrupt input!\n", ifname);
+        exit(1);
+      }
+    }
+    if (h.flags&HDR_SMALL)
+    {
+      blocks+=(h.size>0);
+      if ((h.flags&HDR_DICT) && (!dict.snap || dict.id!=h.dict)) // Can't skip it
+        break;
+      DecompressSmall(in, nullptr, h);
+    }
+    else if (h.table>0)
+    {
+      if (_fseeki64(in, base+h.table, SEEK_SET))
+      {
+        perror("Fseek() failed");
+        exit(1);
+      }
+      blocks=(blocks>=0)?blocks+S64(GetLE(in, 8)):-1;
+    }
+    else
+      blocks=-1;
+
+    if (!NextMember(in, base, h) || !ReadHeader(in, h))
+      break;
+  }
+  h=first;
+
+  _fseeki64(in, 0, SEEK_END);
+  const S64 csize=_ftelli64(in);
+  fclose(in);
+
+  char opt[48];
+  if (h.ver<3)
+    strcpy(opt, "?");
+  else if (h.flags&HDR_REF)
+    strcpy(opt, "ref");
+  else if (h.flags&HDR_DEDUP)
+    strcpy(opt, "dedup");
+  else if (h.flags&HDR_SMALL)
+    strcpy(opt, "small");
+  else if (h.level)
+    sprintf(opt, "-%d%s", h.level, (h.flags&HDR_ADAPTIVE)?"a":"");
+  else
+    sprintf(opt, "-b%lld%s", h.bsize, (h.flags&HDR_ADAPTIVE)?" -a":"");
+  if (h.flags&HDR_DICT)
+    sprintf(&opt[strlen(opt)], " -D%08X", h.dict);
+  if (h.flags&HDR_PARTS)
+    strcat(opt, " -s");
+  if (h.flags&HDR_CODER)
+    strcat(opt, (how==CODER_FAST)?" --fast":" -x");
+  if (members>1)
+    sprintf(&opt[strlen(opt)], " x%d", members);
+
+  if (size>=0 && blocks>=0)
+    printf("%14lld %14lld %6.2f%% %8lld  %-10s %s\n",
+        csize, size, size?csize*100.0/size:0.0, blocks, opt, ifname);
+  else
+    printf("%14lld %14s %7s %8s  %-10s %s\n",
+        csize, "?", "?", "?", opt, ifname);
+
+  total[0]+=csize;
+  if (size>=0 && total[1]>=0)
+    total[1]+=size;
+  else
+    total[1]=-1;
+}
+
+// Size estimation (-E) - blocks of the smallest level's size are taken at
+// even strides over the whole input, 1/SAMPLE of it in all (or up to
+// SAMPLE_MIN of it), sorted and coded into memory, and what they code to is
+// scaled up to the whole file. Each bigger level then takes blocks of its
+// own size at even strides, half the budget of them, and codes them both
+// whole and cut as the level before. How much smaller they get is what that
+// level gains, on the same bytes, over the one before. A level with fewer
+// than STRIDES such blocks in the budget is extrapolated by the last gain
+// per doubling of the block. Inputs within the budget are coded whole.
+// Returns whether some level was extrapolated
+
+const int SAMPLE=8;
+const S64 SAMPLE_MIN=1<<24;
+const int STRIDES=2; // Fewest blocks a level's gain is measured by
+
+int Estimate(const char* ifname)
+{
+  FILE* in=fopen(ifname, "rb");
+  if (!in)
+  {
+    perror(ifname);
+    exit(1);
+  }
+  _fseeki64(in, 0, SEEK_END);
+  const S64 flen=_ftelli64(in);
+
+  S64 budget=flen/SAMPLE;
+  if (budget<SAMPLE_MIN)
+    budget=flen<SAMPLE_MIN?flen:SAMPLE_MIN;
+
+  Block b;
+  b.buf=nullptr;
+  b.ptr=nullptr;
+  b.ptr64=nullptr;
+  S64 bn=0; // Allocated
+  S64 sampled=0;
+
+  // Codes len bytes at pos, cut into blocks of w. Returns the coded size
+
+  auto code=[&](S64 pos, S64 len, S64 w)
+  {
+    if (bn<w)
+    {
+      MemFree(b.buf, bn);
+      MemFree(b.ptr, bn);
+      b.buf=MemAlloc<U8>(w);
+      b.ptr=MemAlloc<int>(w);
+      bn=w;
+    }
+
+    S64 coded=0;
+    for (S64 i=0; i<len; i+=w)
+    {
+      _fseeki64(in, pos+i, SEEK_SET);
+      if ((b.n=S64(fread(b.buf, 1, size_t(len-i<w?len-i:w), in)))<=0)
+        break;
+
+      SortBlock(&b);
+      Part part;
+      EncodePart(b.buf, 0, b.n, b.how, &part);
+      coded+=S64(part.mem.size()); // Block headers are added below
+      sampled+=b.n;
+    }
+    return coded;
+  };
+
+  int partial=0;
+  int guess=0; // Extrapolated
+  S64 w0=-1; // Window of the level before
+  double ratio=0; // Bytes out per byte in
+  double slope=0; // log2 of the gain per doubling of the window
+  double mbps=0;
+  for (int lv=bsize?0:1; lv<=(bsize?0:9); ++lv)
+  {
+    const S64 bs=bsize?bsize:btab[lv];
+    const S64 w=bs<flen?bs:flen; // Window
+    const S64 k=w>0?budget/(2*w):0; // Blocks sampled
+    if (w!=w0)
+      guess=(w0>0 && budget<flen && k<STRIDES);
+
+    const std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    sampled=0;
+    if (w<=0 || w==w0) // Same as the level before
+      ;
+    else if (guess)
+      ratio*=exp2(slope*log2(double(w)/w0));
+    else if (budget>=flen) // All of it
+      ratio=double(code(0, flen, w))/flen;
+    else if (w0<0) // The smallest level
+    {
+      const S64 m=(budget/w>0)?budget/w:1;
+      S64 coded=0;
+      for (S64 j=0; j<m; ++j)
+        coded+=code(flen*j/m+(flen/m-w)/2, w, w);
+      ratio=sampled?double(coded)/sampled:0;
+    }
+    else
+    {
+      S64 whole=0;
+      S64 cut=0;
+      for (S64 j=0; j<k; ++j)
+      {
+        const S64 pos=flen*j/k+(flen/k-w)/2;
+        whole+=code(pos, w, w);
+        cut+=code(pos, w, w0);
+      }
+      if (whole>0 && cut>0)
+      {
+        ratio*=double(whole)/cut;
+        slope=log2(double(whole)/cut)/log2(double(w)/w0);
+      }
+    }
+
+    const double secs=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    if (sampled && secs>0)
+      mbps=sampled/secs/1e6;
+    if (w>0)
+      w0=w;
+
+    const S64 est=S64(ratio*flen)+30+(flen+bs-1)/bs*12;
+
+    char lvl[16];
+    if (lv)
+      snprintf(lvl, sizeof(lvl), "-%d%s", lv, guess?"*":"");
+    else
+      snprintf(lvl, sizeof(lvl), "-b%s", guess?"*":"");
+    char blk[32]; // Room for any S64
+    if (bs>=(1<<20))
+      snprintf(blk, sizeof(blk), "%lld MB", (bs+(1<<19))>>20);
+    else
+      snprintf(blk, sizeof(blk), "%lld KB", (bs+512)>>10);
+
+    printf("%-5s %10s %14lld %6.2f%% %8.2f  %s\n", lvl, blk, est,
+        flen?est*100.0/flen:0.0, mbps, ifname);
+    partial|=guess;
+  }
+  MemFree(b.buf, bn);
+  MemFree(b.ptr, bn);
+
+  fclose(in);
+  return partial;
+}
+
+// FM-index sidecar (--index, --grep, --count) - each block of a .bcm is
+// the BWT of its data, so it's most of an FM-index already. The sidecar
+// ("name.bcmi") holds the rest and no copy of the BWT: for each block, the
+// counts of the symbols before each of its parts, and the row of every
+// FM_SAMPLE-th position, found by walking LF over the decoded block - no
+// temporary file and no sort. A query reads the .bcm block by block, as
+// decompression does, but only decodes the BWT and never inverts it. In
+// blocks coded in parts (-s, --fast, -x) only the parts that the search
+// touches are decoded, blocks in one stream are decoded whole as they are
+// passed, so only a file made with -sN is quick to search. A pattern is
+// found by backward search and is located and shown by walking LF to the
+// nearest sample. Rows count the end of the text, which sorts first and is
+// left out of the BWT. The file is "BCMi", U64 size of the .bcm, the
+// blocks, then U64 count and U64 offset of each block, and last the U64
+// offset of that table. A block is U64 size n, U64 row of the end of text,
+// U32 parts k, U32 counts [k+1][256] before each part (the last are the
+// totals), U32 row of each FM_SAMPLE-th position [(n-1)/FM_SAMPLE+1], then
+// the first and the last min(n, FM_EDGE) bytes of the text. Matches across
+// blocks are found in the text around where they meet, which is mostly in
+// those ends
+
+const int FM_SAMPLE=64;
+const int FM_STEP=1<<12; // Counts kept within a decoded part
+const int FM_LINE=256; // Most of a line shown either side of a match
+const int FM_EDGE=256; // Text kept from each end of a block
+
+void IndexName(const char* ifname, char* name)
+{
+  strcpy(name, ifname);
+  const int p=strlen(name)-4;
+  strcat(name, (p>0 && !strcmp(&name[p], ".bcm"))?"i":".bcmi");
+}
+
+struct FMBlock
+{
+  S64 n;
+  S64 idx;
+  S64 start; // In the data
+  int how;
+  int k; // Parts, 1 for a block in the stream
+  std::vector<S64> at; // Where the parts are in the .bcm
+  std::vector<U8> bwt;
+  std::vector<U8> ready; // Parts decoded
+
+  S64 From(int p) const
+  {
+    return n*p/k;
+  }
+};
+
+void DecodeRun(int how, const std::vector<U8>* mem, U8* dst, S64 n)
+{
+  static const U8 none=0;
+  const U8* src=mem->empty()?&none:&(*mem)[0];
+  const U8* end=src+mem->size();
+  S64 cnt[257]={};
+
+  switch (how)
+  {
+  case CODER_FAST:
+    Fast::Decode(src, end, dst, n);
+    break;
+  case CODER_QUICK:
+    DecodeCM<Quick>(dst, 0, n, src, end, cnt);
+    break;
+  case CODER_STEADY:
+    DecodeCM<Steady>(dst, 0, n, src, end, cnt);
+    break;
+  default:
+    DecodeCM<Balanced>(dst, 0, n, src, end, cnt);
+  }
+}
+
+// The blocks of a .bcm in order, member by member. Of a block in parts,
+// Next() only notes where the parts are and Decode() gets them, the rest
+// are decoded by Next() as the stream goes by
+
+struct BlockReader
+{
+  FILE* in;
+  const char* name;
+  Header h;
+  S64 base; // Of the member
+  S64 next; // Block header, in parts
+  S64 start;
+  CM* cm; // Of a member in one stream
+  int small; // Left of a small member
+
+  void Open(const char* ifname)
+  {
+    name=ifname;
+    if (!(in=fopen(name, "rb")))
+    {
+      perror(name);
+      exit(1);
+    }
+    if (!ReadHeader(in, h))
+    {
+      fprintf(stderr, "%s: Not in BCM format\n", name);
+      exit(1);
+    }
+    base=0;
+    start=0;
+    cm=nullptr;
+    Member();
+  }
+
+  void Close()
+  {
+    delete cm;
+    fclose(in);
+  }
+
+  void Member()
+  {
+    if (h.flags&(HDR_REF|HDR_DEDUP))
+    {
+      fprintf(stderr, "%s: Made with --ref or --dedup, can't be indexed\n", name);
+      exit(1);
+    }
+    if ((h.flags&HDR_DICT) && (!dict.snap || dict.id!=h.dict))
+    {
+      fprintf(stderr, "Dictionary %08X is needed (-D)\n", h.dict);
+      exit(1);
+    }
+
+    delete cm;
+    cm=nullptr;
+    small=(h.flags&HDR_SMALL) && h.size>0;
+    if (!(h.flags&(HDR_SMALL|HDR_PARTS)))
+    {
+      cm=new CM(in, nullptr);
+      if (dict.snap)
+        cm->Prime(dict.snap);
+      cm->Init();
+    }
+    next=_ftelli64(in);
+  }
+
+  void Corrupt()
+  {
+    fprintf(stderr, "%s: Corrupt input!\n", name);
+    exit(1);
+  }
+
+  // The BWT of the stream from cm, all of it
+
+  void Stream(FMBlock& b, CM& c)
+  {
+    b.k=1;
+    b.ready.assign(1, 1);
+    b.bwt.resize(size_t(b.n));
+    for (S64 i=0; i<b.n; ++i)
+      b.bwt[size_t(i)]=U8(c.Get());
+  }
+
+  int Next(FMBlock& b)
+  {
+    for (;;)
+    {
+      if (small)
+      {
+        b.n=h.size;
+        b.idx=S64(GetVar(in));
+        GetLE(in, 4);
+        b.how=CODER_CM;
+        if (b.idx<1 || b.idx>b.n)
+          Corrupt();
+        CM* c=new CM(in, nullptr);
+        if (dict.snap)
+          c->Prime(dict.snap);
+        c->Init();
+        Stream(b, *c);
+        delete c;
+        small=0;
+        break;
+      }
+      else if (cm)
+      {
+        const U32 x=cm->Get32();
+        if (x)
+        {
+          b.n=x;
+          if (x&0x80000000)
+          {
+            b.n=(S64(x&0x7FFFFFFF)<<32)+cm->Get32();
+            b.idx=S64(cm->Get32())<<32;
+            b.idx+=cm->Get32();
+          }
+          else
+            b.idx=cm->Get32();
+          if (h.ver>1)
+            cm->Get32(); // CRC32
+          b.how=CODER_CM;
+          if (b.idx<1 || b.idx>b.n || (h.bsize>0 && b.n>h.bsize) || b.n>0xFFFFFFFE)
+            Corrupt();
+          Stream(b, *cm);
+          break;
+        }
+      }
+      else if (h.flags&HDR_PARTS)
+      {
+        _fseeki64(in, next, SEEK_SET);
+        if ((b.n=S64(GetVar(in)))>0)
+        {
+          b.idx=S64(GetVar(in));
+          GetLE(in, 4);
+          b.how=CODER_CM;
+          if ((h.flags&HDR_CODER) && ((b.how=getc(in))<0 || b.how>=CODERS))
+            Corrupt();
+          if ((b.k=getc(in))<1 || b.idx<1 || b.idx>b.n || (h.bsize>0 && b.n>h.bsize)
+              || b.n>0xFFFFFFFE)
+            Corrupt();
+          b.at.resize(size_t(b.k)+1);
+          S64 left=b.n+(b.n>>3)+1024; // As in DecodeParts()
+          for (int j=0; j<b.k; ++j)
+          {
+            const S64 len=S64(GetVar(in));
+            if (len<0 || len>left)
+              Corrupt();
+            left-=len;
+            b.at[j+1]=len;
+          }
+          b.at[0]=_ftelli64(in);
+          for (int j=1; j<=b.k; ++j)
+            b.at[j]+=b.at[j-1];
+          next=b.at[b.k];
+          b.ready.assign(size_t(b.k), 0);
+          b.bwt.resize(size_t(b.n));
+          break;
+        }
+      }
+
+      // The member is done
+      if (h.ver<3 || !NextMember(in, base, h))
+        return 0;
+      if (!ReadHeader(in, h))
+      {
+        fprintf(stderr, "%s: Garbage after the stream\n", name);
+        exit(1);
+      }
+      Member();
+    }
+
+    b.start=start;
+    start+=b.n;
+    return 1;
+  }
+
+  // Reads part p of b and decodes it, or them all if p<0, on the pool
+
+  void Decode(FMBlock& b, int p)
+  {
+    const int from=(p<0)?0:p;
+    const int to=(p<0)?b.k:p+1;
+    const S64 pos=_ftelli64(in); // A stream may be half read
+    InPart* part=new InPart[to-from];
+    for (int j=from; j<to; ++j)
+    {
+      std::vector<U8>& mem=part[j-from].mem;
+      if (b.ready[j])
+        continue;
+      mem.resize(size_t(b.at[j+1]-b.at[j]));
+      _fseeki64(in, b.at[j], SEEK_SET);
+      if (!mem.empty() && fread(&mem[0], 1, mem.size(), in)!=mem.size())
+      {
+        fprintf(stderr, "%s: Unexpected end of file!\n", name);
+        exit(1);
+      }
+      pool.Spawn(part[j-from].done, std::bind(DecodeRun, b.how, &mem, &b.bwt[size_t(b.From(j))],
+          b.From(j+1)-b.From(j)));
+    }
+    for (int j=from; j<to; ++j)
+    {
+      if (!b.ready[j])
+        pool.Wait(part[j-from].done);
+      b.ready[j]=1;
+    }
+    delete[] part;
+    _fseeki64(in, pos, SEEK_SET);
+  }
+};
+
+void BuildIndex(const char* ifname)
+{
+  BlockReader rd;
+  rd.Open(ifname);
+
+  char name[FILENAME_MAX];
+  IndexName(ifname, name);
+  FILE* out=fopen(name, "wb");
+  if (!out)
+  {
+    perror(name);
+    exit(1);
+  }
+  struct _stati64 sb;
+  if (_stati64(ifname, &sb))
+  {
+    perror(ifname);
+    exit(1);
+  }
+  fwrite("BCMi", 1, 4, out);
+  PutLE(out, S64(sb.st_size), 8);
+
+  FMBlock b;
+  std::vector<U32> lf;
+  std::vector<S64> where;
+  while (rd.Next(b))
+  {
+    rd.Decode(b, -1);
+    const S64 n=b.n;
+    const S64 idx=b.idx;
+    where.push_back(_ftelli64(out));
+    PutLE(out, n, 8);
+    PutLE(out, idx, 8);
+    PutLE(out, b.k, 4);
+
+    U32 cnt[256]={};
+    for (int j=0; j<=b.k; ++j)
+    {
+      for (int c=0; c<256; ++c)
+        PutLE(out, cnt[c], 4);
+      for (S64 i=(j<b.k)?b.From(j):n; i<((j<b.k)?b.From(j+1):n); ++i)
+        ++cnt[b.bwt[size_t(i)]];
+    }
+
+    // LF of every row, then the walk from the end of the text back
+
+    U32 next[256];
+    U32 sum=1;
+    for (int c=0; c<256; ++c)
+    {
+      next[c]=sum;
+      sum+=cnt[c];
+    }
+    lf.resize(size_t(n)+1);
+    for (S64 i=0; i<=n; ++i)
+    {
+      if (i!=idx)
+        lf[size_t(i)]=next[b.bwt[size_t(i-(i>idx))]]++;
+    }
+    std::vector<U32> isa(size_t((n-1)/FM_SAMPLE+1));
+    const S64 e=(n<FM_EDGE)?n:FM_EDGE;
+    std::vector<U8> edge(size_t(e*2));
+    U32 row=0;
+    for (S64 p=n-1; p>=0; --p)
+    {
+      if (p<e || p>=n-e) // T[p] is L of the row of p+1
+      {
+        const U8 c=b.bwt[size_t(row-(row>idx))];
+        if (p<e)
+          edge[size_t(p)]=c;
+        if (p>=n-e)
+          edge[size_t(p-n+e*2)]=c;
+      }
+      row=lf[row];
+      if (p%FM_SAMPLE==0)
+        isa[size_t(p/FM_SAMPLE)]=row;
+    }
+    if (row!=U32(idx))
+    {
+      fprintf(stderr, "%s: Corrupt input!\n", ifname);
+      exit(1);
+    }
+    for (size_t i=0; i<isa.size(); ++i)
+      PutLE(out, isa[i], 4);
+    fwrite(&edge[0], 1, edge.size(), out);
+  }
+  const S64 size=rd.start;
+  rd.Close();
+
+  const S64 t=_ftelli64(out);
+  PutLE(out, where.size(), 8);
+  for (size_t i=0; i<where.size(); ++i)
+    PutLE(out, where[i], 8);
+  PutLE(out, t, 8);
+  const S64 isize=_ftelli64(out);
+  if (fclose(out))
+  {
+    perror(name);
+    exit(1);
+  }
+
+  fprintf(stderr, "%s: %lld bytes indexed -> %s (%lld)\n", ifname, size, name, isize);
+}
+
+// A query reads the blocks in turn and keeps the one searched, those after
+// it that a match or a line shown runs into, and the text at the end of
+// the ones before
+
+struct FMIndex
+{
+  struct Held
+  {
+    FMBlock b;
+    const U8* cnt; // In the sidecar
+    const U8* isa;
+    const U8* edge; // First and last bytes of the text
+    S64 C[256]; // Rows before those that start with each symbol
+    std::vector<std::vector<U32> > step; // Of each part, [rows/FM_STEP+1][256]
+    std::vector<std::pair<U32, U32> > mark; // Sampled row, position/FM_SAMPLE
+  };
+
+  const char* name;
+  const U8* mem;
+  S64 len;
+  U64 t; // Block table
+  S64 blocks;
+  BlockReader rd;
+  std::vector<Held*> held; // The block searched first, then those after it
+  std::vector<Held*> spare;
+  std::vector<U8> tail; // Text before held
+  S64 loaded; // Blocks
+  int eof; // Loaded them all
+
+  static U64 LE(const U8* p, int n)
+  {
+    U64 x=0;
+    for (int i=n-1; i>=0; --i)
+      x=(x<<8)|p[i];
+    return x;
+  }
+
+  void Corrupt()
+  {
+    char iname[FILENAME_MAX];
+    IndexName(name, iname);
+    fprintf(stderr, "%s: Corrupt index\n", iname);
+    exit(1);
+  }
+
+  void Open(const char* ifname)
+  {
+    name=ifname;
+    char iname[FILENAME_MAX];
+    IndexName(ifname, iname);
+    mem=MapFile(iname, len);
+
+    struct _stati64 sb;
+    if (_stati64(ifname, &sb))
+    {
+      perror(ifname);
+      exit(1);
+    }
+    if (len<28 || memcmp(mem, "BCMi", 4))
+      Corrupt();
+    if (S64(LE(&mem[4], 8))!=S64(sb.st_size))
+    {
+      fprintf(stderr, "%s: Out of date, run --index again\n", iname);
+      exit(1);
+    }
+
+    t=LE(&mem[len-8], 8);
+    if (t>U64(len-16))
+      Corrupt();
+    blocks=S64(LE(&mem[t], 8));
+    if (U64(blocks)>(U64(len)-t-16)/8)
+      Corrupt();
+
+    rd.Open(ifname);
+    loaded=0;
+    eof=0;
+    tail.clear();
+    Hold(0);
+  }
+
+  void Close()
+  {
+    rd.Close();
+    for (size_t i=0; i<held.size(); ++i)
+      delete held[i];
+    for (size_t i=0; i<spare.size(); ++i)
+      delete spare[i];
+#ifdef _MSC_VER
+    free((void*)mem);
+#else
+    if (len>0)
+      munmap((void*)mem, size_t(len));
+#endif
+  }
+
+  // Reads the next block of the .bcm to x and checks it against the index
+
+  int Load(Held& x)
+  {
+    const S64 i=loaded;
+    if (!rd.Next(x.b))
+    {
+      if (i!=blocks)
+        Corrupt();
+      return 0;
+    }
+    if (i>=blocks)
+      Corrupt();
+    ++loaded;
+
+    const U64 at=LE(&mem[t+8+i*8], 8);
+    if (at>U64(len-20))
+      Corrupt();
+    const U8* p=&mem[at];
+    const FMBlock& b=x.b;
+    if (S64(LE(p, 8))!=b.n || S64(LE(p+8, 8))!=b.idx || int(LE(p+16, 4))!=b.k)
+    {
+      fprintf(stderr, "%s: Doesn't match its index, run --index again\n", name);
+      exit(1);
+    }
+    x.cnt=p+20;
+    x.isa=x.cnt+(b.k+1)*1024;
+    x.edge=x.isa+((b.n-1)/FM_SAMPLE+1)*4;
+    if (x.edge+((b.n<FM_EDGE)?b.n:FM_EDGE)*2>mem+len)
+      Corrupt();
+
+    S64 c=1;
+    for (int j=0; j<256; ++j)
+    {
+      x.C[j]=c;
+      c+=S64(LE(x.cnt+b.k*1024+j*4, 4));
+    }
+    if (c!=b.n+1)
+      Corrupt();
+
+    x.step.assign(size_t(b.k), std::vector<U32>());
+    x.mark.resize(size_t((b.n-1)/FM_SAMPLE+1));
+    for (size_t j=0; j<x.mark.size(); ++j)
+    {
+      x.mark[j].first=U32(LE(x.isa+j*4, 4));
+      x.mark[j].second=U32(j);
+      if (x.mark[j].first>b.n)
+        Corrupt();
+    }
+    std::sort(x.mark.begin(), x.mark.end());
+    return 1;
+  }
+
+  // Loads blocks until the text held runs to end or there are no more.
+  // Returns whether a block is held
+
+  int Hold(S64 end)
+  {
+    while (!eof && (held.empty() || High()<end))
+    {
+      Held* x;
+      if (spare.empty())
+        x=new Held;
+      else
+      {
+        x=spare.back();
+        spare.pop_back();
+      }
+      if (Load(*x))
+        held.push_back(x);
+      else
+      {
+        spare.push_back(x);
+        eof=1;
+      }
+    }
+    return !held.empty();
+  }
+
+  // Moves on to the next block, keeping up to keep bytes of text before it
+
+  int Advance(S64 keep)
+  {
+    if (held.size()<2)
+      Hold(High()+1);
+    if (held.size()<2)
+      return 0;
+    const S64 e=held[1]->b.start;
+    const S64 f=(e-keep>Low())?e-keep:Low();
+    std::vector<U8> t(size_t(e-f));
+    if (e>f)
+      Text(f, e, &t[0]);
+    tail.swap(t);
+
+    spare.push_back(held[0]);
+    held.erase(held.begin());
+    return 1;
+  }
+
+  S64 Low() const // Where the text held starts
+  {
+    return held[0]->b.start-S64(tail.size());
+  }
+
+  S64 High() const // and ends
+  {
+    const FMBlock& b=held.back()->b;
+    return b.start+b.n;
+  }
+
+  int Part(const Held& x, S64 u) // Of row u, the end of text left out
+  {
+    const FMBlock& b=x.b;
+    int p=int(u*b.k/b.n);
+    while (p+1<b.k && b.From(p+1)<=u)
+      ++p;
+    while (p>0 && b.From(p)>u)
+      --p;
+    return p;
+  }
+
+  void Ready(Held& x, int p)
+  {
+    FMBlock& b=x.b;
+    if (!b.ready[size_t(p)])
+      rd.Decode(b, p);
+    std::vector<U32>& st=x.step[size_t(p)];
+    if (!st.empty())
+      return;
+
+    const S64 from=b.From(p);
+    const S64 to=b.From(p+1);
+    st.assign(size_t((to-from)/FM_STEP+1)*256, 0);
+    for (S64 i=FM_STEP; i<to-from; i+=FM_STEP)
+    {
+      U32* o=&st[size_t(i/FM_STEP*256)];
+      memcpy(o, o-256, 1024);
+      for (S64 j=from+i-FM_STEP; j<from+i; ++j)
+        ++o[b.bwt[size_t(j)]];
+    }
+  }
+
+  S64 Rank(Held& x, int c, S64 row) // Of c in the rows before row
+  {
+    const FMBlock& b=x.b;
+    if (row==0)
+      return 0;
+    const S64 u=(row>b.idx)?row-1:row;
+    if (u==b.n)
+      return S64(LE(x.cnt+b.k*1024+c*4, 4));
+    const int p=Part(x, u);
+    Ready(x, p);
+    const S64 from=b.From(p);
+    const S64 e=(u-from)/FM_STEP*FM_STEP;
+    S64 r=S64(LE(x.cnt+p*1024+c*4, 4))+x.step[size_t(p)][size_t(e/FM_STEP*256+c)];
+    for (S64 i=from+e; i<u; ++i)
+      r+=(b.bwt[size_t(i)]==c);
+    return r;
+  }
+
+  int At(Held& x, S64 row) // -1 - the end of text
+  {
+    const FMBlock& b=x.b;
+    if (row==b.idx)
+      return -1;
+    const S64 u=(row>b.idx)?row-1:row;
+    const int p=Part(x, u);
+    Ready(x, p);
+    return b.bwt[size_t(u)];
+  }
+
+  S64 LF(Held& x, S64 row)
+  {
+    const int c=At(x, row);
+    return (c<0)?0:x.C[c]+Rank(x, c, row);
+  }
+
+  S64 Locate(Held& x, S64 row)
+  {
+    for (S64 k=0;; ++k)
+    {
+      if (row==x.b.idx)
+        return k;
+      const std::pair<U32, U32> key(U32(row), 0);
+      std::vector<std::pair<U32, U32> >::const_iterator it=
+        std::lower_bound(x.mark.begin(), x.mark.end(), key);
+      if (it!=x.mark.end() && it->first==key.first)
+        return S64(it->second)*FM_SAMPLE+k;
+      row=LF(x, row);
+    }
+  }
+
+  void Extract(Held& x, S64 from, S64 to, U8* dst) // Within the block
+  {
+    const FMBlock& b=x.b;
+    const S64 e=(b.n<FM_EDGE)?b.n:FM_EDGE;
+    if (to<=e || from>=b.n-e) // Kept in the index
+    {
+      memcpy(dst, x.edge+((to<=e)?from:from-b.n+e*2), size_t(to-from));
+      return;
+    }
+    S64 j=(to+FM_SAMPLE-1)/FM_SAMPLE*FM_SAMPLE;
+    S64 row=0;
+    if (j<b.n)
+      row=S64(LE(x.isa+(j/FM_SAMPLE)*4, 4));
+    else
+      j=b.n;
+    for (S64 i=j-1; i>=from; --i)
+    {
+      const int c=At(x, row);
+      if (i<to)
+        dst[i-from]=U8(c);
+      row=LF(x, row);
+    }
+  }
+
+  void Text(S64 from, S64 to, U8* dst) // Of what is held
+  {
+    const S64 s=held[0]->b.start;
+    if (from<s)
+    {
+      const S64 e=(to<s)?to:s;
+      memcpy(dst, &tail[size_t(from-Low())], size_t(e-from));
+      dst+=e-from;
+      from=e;
+    }
+    for (size_t i=0; i<held.size() && from<to; ++i)
+    {
+      const FMBlock& b=held[i]->b;
+      if (from>=b.start+b.n)
+        continue;
+      const S64 e=(to<b.start+b.n)?to:b.start+b.n;
+      Extract(*held[i], from-b.start, e-b.start, dst);
+      dst+=e-from;
+      from=e;
+    }
+  }
+
+  // Puts the line around m bytes at p, up to FM_LINE either side, in line
+  // and returns where it starts. The text is got FM_SAMPLE bytes at a time,
+  // as each of those costs as much to get as one byte
+
+  S64 Line(S64 p, int m, std::vector<U8>& line)
+  {
+    U8 seg[FM_SAMPLE];
+    Hold(p+m+FM_LINE);
+    line.resize(size_t(m));
+    Text(p, p+m, &line[0]);
+
+    const S64 lo=(p-FM_LINE>Low())?p-FM_LINE:Low();
+    S64 a=p;
+    while (a>lo)
+    {
+      S64 f=(a-1)/FM_SAMPLE*FM_SAMPLE;
+      if (f<lo)
+        f=lo;
+      Text(f, a, seg);
+      S64 i=a-f;
+      while (i>0 && seg[i-1]!='\n')
+        --i;
+      line.insert(line.begin(), seg+i, seg+(a-f));
+      a=f+i;
+      if (i>0)
+        break;
+    }
+
+    const S64 hi=(p+m+FM_LINE<High())?p+m+FM_LINE:High();
+    S64 e=p+m;
+    while (e<hi)
+    {
+      S64 t=(e/FM_SAMPLE+1)*FM_SAMPLE;
+      if (t>hi)
+        t=hi;
+      Text(e, t, seg);
+      S64 i=0;
+      while (e+i<t && seg[i]!='\n')
+        ++i;
+      line.insert(line.end(), seg, seg+i);
+      if (e+i<t)
+        break;
+      e=t;
+    }
+
+    return a;
+  }
+
+  // Counts the matches of p that start in the block searched, and puts
+  // where they are in pos, if given
+
+  S64 Find(const U8* p, int m, std::vector<S64>* pos)
+  {
+    Held& x=*held[0];
+    const FMBlock& b=x.b;
+    S64 lo=0;
+    S64 hi=b.n+1;
+    for (int i=m-1; i>=0 && lo<hi; --i)
+    {
+      lo=x.C[p[i]]+Rank(x, p[i], lo);
+      hi=x.C[p[i]]+Rank(x, p[i], hi);
+    }
+    S64 found=0;
+    if (lo<hi)
+    {
+      found=hi-lo;
+      for (S64 r=lo; pos && r<hi; ++r)
+        pos->push_back(b.start+Locate(x, r));
+    }
+
+    const S64 s=b.start+b.n;
+    if (m>1 && Hold(s+m-1) && High()>s) // Across into the blocks after
+    {
+      const S64 from=(s-m+1>b.start)?s-m+1:b.start;
+      const S64 to=(s+m-1<High())?s+m-1:High();
+      std::vector<U8> buf(size_t(to-from));
+      Text(from, to, &buf[0]);
+      for (S64 i=from; i<s && i+m<=to; ++i)
+      {
+        if (!memcmp(&buf[size_t(i-from)], p, m))
+        {
+          ++found;
+          if (pos)
+            pos->push_back(i);
+        }
+      }
+    }
+
+    return found;
+  }
+};
+
+// Prints the count, or each line with a match as its offset and the line,
+// for each file. Returns whether anything was found
+
+int Grep(const std::vector<std::string>& files)
+{
+  const int m=int(strlen(pattern));
+  if (!m)
+  {
+    fprintf(stderr, "Empty pattern\n");
+    exit(1);
+  }
+
+  S64 total=0;
+  for (size_t i=0; i<files.size(); ++i)
   {
-    if (getc(in)!=magic[0]
-        || getc(in)!=magic[1]
-        || getc(in)!=magic[2]
-        || getc(in)!=magic[3])
+    const char* name=files[i].c_str();
+    FMIndex* fm=new FMIndex;
+    fm->Open(name);
+
+    S64 n=0;
+    S64 last=-1; // End of the line shown
+    std::vector<S64> pos;
+    std::vector<U8> line;
+    do
     {
-      fprintf(stderr, "%s: Not in BCM format\n", argv[1]);
-      exit(1);
+      if (fm->held.empty())
+        break;
+      pos.clear();
+      n+=fm->Find((const U8*)pattern, m, count?nullptr:&pos);
+      std::sort(pos.begin(), pos.end());
+      for (size_t j=0; j<pos.size(); ++j)
+      {
+        if (pos[j]<last) // On the line shown
+          continue;
+        const S64 a=fm->Line(pos[j], m, line);
+        last=a+S64(line.size());
+
+        if (files.size()>1)
+          printf("%s:", name);
+        printf("%lld:", a);
+        fwrite(&line[0], 1, line.size(), stdout);
+        putchar('\n');
+      }
     }
+    while (fm->Advance(count?0:FM_LINE+m));
 
-    out=fopen(ofname, "wb");
-    if (!out)
+    total+=n;
+    if (count)
     {
-      perror(ofname);
-      exit(1);
+      if (files.size()>1)
+        printf("%s:", name);
+      printf("%lld\n", n);
     }
 
-    fprintf(stderr, "Decompressing '%s':\n", argv[1]);
+    fm->Close();
+    delete fm;
+  }
+
+  return total>0;
+}
 
-    Decompress();
+void OutName(const char* ifname, char* ofname)
+{
+  strcpy(ofname, ifname);
+  if (decompress)
+  {
+    const int p=strlen(ofname)-4;
+    if (p>0 && !strcmp(&ofname[p], ".bcm"))
+      ofname[p]='\0';
+    else
+      strcat(ofname, ".out");
   }
   else
+    strcat(ofname, ".bcm");
+}
+
+// Batch mode - collect the files, recursing into directories. In there,
+// only .bcm files are decompressed and they are skipped when compressing
+
+void Collect(const std::string& path, int named, std::vector<std::string>& files)
+{
+  struct _stati64 sb;
+  if (_stati64(path.c_str(), &sb))
   {
-    out=fopen(ofname, "wb");
-    if (!out)
+    perror(path.c_str());
+    exit(1);
+  }
+
+  if ((sb.st_mode&S_IFMT)==S_IFDIR)
+  {
+    std::vector<std::string> names;
+#ifdef _MSC_VER
+    struct _finddata_t fd;
+    const intptr_t h=_findfirst((path+"\\*").c_str(), &fd);
+    if (h!=-1)
     {
-      perror(ofname);
+      do
+        names.push_back(fd.name);
+      while (!_findnext(h, &fd));
+      _findclose(h);
+    }
+#else
+    DIR* dir=opendir(path.c_str());
+    if (!dir)
+    {
+      perror(path.c_str());
       exit(1);
     }
+    while (struct dirent* e=readdir(dir))
+      names.push_back(e->d_name);
+    closedir(dir);
+#endif
+
+    for (size_t i=0; i<names.size(); ++i)
+    {
+      if (names[i]!="." && names[i]!="..")
+        Collect(path+"/"+names[i], 0, files);
+    }
+  }
+  else if ((sb.st_mode&S_IFMT)==S_IFREG)
+  {
+    const int bcm=(path.size()>4 && !path.compare(path.size()-4, 4, ".bcm"));
+    if (named || bcm==decompress)
+      files.push_back(path);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+
+  while (argc>1 && *argv[1]=='-')
+  {
+    if (!strcmp(argv[1], "--train"))
+    {
+      train=1;
+      --argc;
+      ++argv;
+      continue;
+    }
+    if ((!strcmp(argv[1], "--daemon") || !strcmp(argv[1], "--via")) && argc>2)
+    {
+      *(argv[1][2]=='d'?&sname:&via)=argv[2];
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if ((!strcmp(argv[1], "--jobs") || !strcmp(argv[1], "--queue")) && argc>2)
+    {
+      const int x=atoi(argv[2]);
+      if (x<1 || x>4096)
+      {
+        fprintf(stderr, "Invalid %s '%s'\n", &argv[1][2], argv[2]);
+        exit(1);
+      }
+      *(argv[1][2]=='j'?&jobs:&queue)=x;
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if (!strcmp(argv[1], "--index"))
+    {
+      fmindex=1;
+      --argc;
+      ++argv;
+      continue;
+    }
+    if ((!strcmp(argv[1], "--grep") || !strcmp(argv[1], "--count")) && argc>2)
+    {
+      count=(argv[1][2]=='c');
+      pattern=argv[2];
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if (!strcmp(argv[1], "--numa"))
+    {
+      numa=1;
+      --argc;
+      ++argv;
+      continue;
+    }
+    if (!strcmp(argv[1], "--part") && argc>2)
+    {
+      char c;
+      if (sscanf(argv[2], "%d/%d%c", &part, &nparts, &c)!=2
+          || part<1 || part>nparts)
+      {
+        fprintf(stderr, "Invalid part '%s', should be k/N\n", argv[2]);
+        exit(1);
+      }
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if (!strcmp(argv[1], "--fast"))
+    {
+      coder=CODER_FAST;
+      --argc;
+      ++argv;
+      continue;
+    }
+    if (!strcmp(argv[1], "--dedup"))
+    {
+      dedup=1;
+      --argc;
+      ++argv;
+      continue;
+    }
+    if (!strcmp(argv[1], "--ref") && argc>2)
+    {
+      rname=argv[2];
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if (!strcmp(argv[1], "--cpus") && argc>2)
+    {
+      cpus=argv[2];
+      argc-=2;
+      argv+=2;
+      continue;
+    }
+    if (!strcmp(argv[1], "--target-rate") && argc>2)
+    {
+      char* p;
+      if ((rate=strtod(argv[2], &p))<=0 || *p!='\0')
+      {
+        fprintf(stderr, "Invalid rate '%s'\n", argv[2]);
+        exit(1);
+      }
+      argc-=2;
+      argv+=2;
+      continue;
+    }
 
-    putc(magic[0], out);
-    putc(magic[1], out);
-    putc(magic[2], out);
-    putc(magic[3], out);
+    for (int i=1; argv[1][i]!='\0'; ++i)
+    {
+      switch (argv[1][i])
+      {
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+        level=argv[1][i]-'0';
+        break;
+      case 'a':
+        adaptive=1;
+        break;
+      case 'x':
+        trial=1;
+        break;
+      case 'd':
+        decompress=1;
+        break;
+      case 'f':
+        overwrite=1;
+        break;
+      case 'T':
+        decompress=1;
+        test=1;
+        break;
+      case 'l':
+        decompress=1;
+        list=1;
+        break;
+      case 'E':
+        estimate=1;
+        break;
+      case 'D':
+        if (argv[1][i+1]!='\0')
+          dname=&argv[1][i+1];
+        else if (argc>2) // -D dict
+        {
+          dname=argv[2];
+          argv[2]=argv[1];
+          --argc;
+          ++argv;
+        }
+        else
+        {
+          fprintf(stderr, "No dictionary given\n");
+          exit(1);
+        }
+        i=strlen(argv[1])-1;
+        break;
+      case 'r':
+        batch=1;
+        break;
+      case 'b':
+      case 's':
+      case 't':
+        {
+          const int opt=argv[1][i];
+          char* p;
+          errno=0;
+          S64 x=strtoll(&argv[1][i+1], &p, 10);
+          int shift=0;
+          if (opt=='b')
+          {
+            switch (*p)
+            {
+            case 'k': case 'K': shift=10; ++p; break;
+            case 'm': case 'M': shift=20; ++p; break;
+            case 'g': case 'G': shift=30; ++p; break;
+            }
+          }
+          if (errno || x>(S64(~0ULL>>1)>>shift))
+            x=0; // Overflows
+          x<<=shift;
+          if (x<1 || *p!='\0' || (opt=='t' && x>1024) || (opt=='s' && x>255))
+          {
+            fprintf(stderr, "Invalid %s '%s'\n", opt=='b'?"block size"
+                :opt=='s'?"number of streams":"number of threads", &argv[1][i+1]);
+            exit(1);
+          }
+          if (opt=='b')
+            bsize=x;
+          else if (opt=='s')
+            streams=int(x);
+          else
+            threads=int(x);
+          i=p-argv[1]-1;
+        }
+        break;
+      default:
+        fprintf(stderr, "Unknown option '-%c'\n", argv[1][i]);
+        exit(1);
+      }
+    }
 
-    fprintf(stderr, "Compressing '%s':\n", argv[1]);
+    --argc;
+    ++argv;
+  }
 
-    Compress(level);
+  if (argc<2 && !sname)
+  {
+    fprintf(stderr,
+        "BCM - A BWT-based file compressor, v1.60\n"
+        "Copyright (C) 2008-2021 Ilya Muravyov\n"
+        "\n"
+        "Usage: BCM [options] infile [outfile]\n"
+        "       BCM [options] -r file|dir ...\n"
+        "       BCM --train -D dict file|dir ...\n"
+        "       BCM [options] --daemon socket\n"
+        "       BCM --index|--grep text|--count text file.bcm ...\n"
+        "\n"
+        "Options:\n"
+        "  -1 .. -9 Set block size to 1 MB .. 2 GB\n"
+        "  -bN      Set block size to N bytes (k, m, g suffixes), over 2 GB\n"
+        "           uses 9*N memory to compress and 8*N to decompress (5*N\n"
+        "           and 4*N below); with more than one thread, twice that\n"
+        "           where it fits in half of the RAM, to overlap blocks\n"
+        "  -a       Adapt block boundaries to the data\n"
+        "  -x       Try a few models on each block and code it by the best\n"
+        "  -d       Decompress\n"
+        "  -f       Force overwrite of output file\n"
+        "  -T       Test integrity, no output is written\n"
+        "  -l       List sizes and settings from the headers\n"
+        "  -E       Estimate the compressed size at each level from samples\n"
+        "  -D dict  Prime the model with a dictionary, made by --train\n"
+        "  -r       Process each file to its own .bcm (or back), recursing\n"
+        "           into directories; implied by more than two files\n"
+        "  -tN      Use N threads (default: all cores)\n"
+        "  -sN      Code each block as up to N streams, in parallel\n"
+        "  --fast   Code blocks with MTF and rANS instead of CM: several times\n"
+        "           quicker both ways, for a bigger output\n"
+        "  --target-rate R\n"
+        "           Keep up with R MB/s of input, trading ratio for speed with\n"
+        "           smaller blocks and more streams as needed\n"
+        "  --part k/N\n"
+        "           Compress the k-th of N equal byte ranges of the file, the\n"
+        "           parts of all k concatenated decompress to the whole file\n"
+        "  --ref file\n"
+        "           Code the input as changes to file, which is needed to\n"
+        "           decompress it as well\n"
+        "  --dedup  Code repeats of chunks of the input, anywhere in it, as\n"
+        "           copies, before the blocks are sorted\n"
+        "  --cpus L Run on the CPUs in list L, e.g. 0-7,16-23\n"
+        "  --numa   Keep each block's threads and memory on one NUMA node\n"
+        "  --daemon socket\n"
+        "           Serve jobs on a Unix socket, with --jobs N workers (1) and\n"
+        "           up to --queue N connections waiting (64)\n"
+        "  --via socket\n"
+        "           Have the daemon on socket do the work, not with --part,\n"
+        "           -D, --ref, --target-rate or -t\n"
+        "  --index  Write an FM-index next to each .bcm, as .bcmi\n"
+        "  --grep text\n"
+        "           Show the lines with text, found by the index\n"
+        "  --count text\n"
+        "           Count the matches of text, found by the index. Blocks\n"
+        "           in one stream are decoded whole, of those made with -sN\n"
+        "           only the parts searched\n");
+    exit(1);
   }
 
-  fprintf(stderr, "%lld -> %lld in %1.1f sec\n",
-      _ftelli64(in), _ftelli64(out), double(clock()-start)/CLOCKS_PER_SEC);
+  if (argc>((test || estimate)?2:3)) // A test takes no outfile
+    batch=1;
 
-  fclose(in);
-  fclose(out);
+  if (via && (nparts || dname || rname || rate>0 || threads)) // Not sent
+  {
+    fprintf(stderr, "--via can't go with %s\n", nparts?"--part":dname?"-D"
+        :rname?"--ref":rate>0?"--target-rate":"-t");
+    exit(1);
+  }
 
-#ifndef NO_UTIME
-  struct _stati64 sb;
-  if (_stati64(argv[1], &sb))
+  const int ncpu=topo.Init();
+  if (!threads)
+    threads=(cpus || numa)?ncpu:int(std::thread::hardware_concurrency());
+  if (threads<1)
+    threads=1;
+
+  CRC::Init();
+
+  if (train)
   {
-    perror("Stat() failed");
+    if (!dname)
+    {
+      fprintf(stderr, "--train needs -D dict to write\n");
+      exit(1);
+    }
+
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i)
+      Collect(argv[i], 1, files);
+    Train(files, dname);
+
+    return 0;
+  }
+
+  if (dname)
+    dict.Load(dname);
+
+  if ((rname || dedup) && nparts)
+  {
+    fprintf(stderr, "--%s can't go with --part\n", rname?"ref":"dedup");
     exit(1);
   }
-  struct utimbuf ub;
-  ub.actime=sb.st_atime;
-  ub.modtime=sb.st_mtime;
-  if (utime(ofname, &ub))
+  if (rname && dedup)
   {
-    perror("Utime() failed");
+    fprintf(stderr, "--ref can't go with --dedup\n");
     exit(1);
   }
-#endif
+
+  if (rname)
+  {
+    ref.Load(rname);
+    if (!decompress && !test && !list && !estimate)
+      ref.Index();
+  }
+
+  if (list)
+  {
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i)
+      Collect(argv[i], 1, files);
+
+    printf("%14s %14s %7s %8s  %-10s %s\n",
+        "compressed", "original", "ratio", "blocks", "options", "name");
+    S64 total[2]={0, 0};
+    for (size_t i=0; i<files.size(); ++i)
+      List(files[i].c_str(), total);
+
+    if (files.size()>1)
+    {
+      if (total[1]>=0)
+        printf("%14lld %14lld %6.2f%% %8s  %-10s (%d files)\n",
+            total[0], total[1], total[1]?total[0]*100.0/total[1]:0.0, "", "", int(files.size()));
+      else
+        printf("%14lld %14s %7s %8s  %-10s (%d files)\n",
+            total[0], "?", "?", "", "", int(files.size()));
+    }
+
+    return 0;
+  }
+
+  if (estimate)
+  {
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i)
+      Collect(argv[i], 1, files);
+
+    printf("%-5s %10s %14s %7s %8s  %s\n",
+        "level", "block", "estimate", "ratio", "MB/s", "name");
+    int partial=0;
+    for (size_t i=0; i<files.size(); ++i)
+      partial|=Estimate(files[i].c_str());
+    if (partial)
+      printf("* Extrapolated from the smaller blocks\n");
+
+    return 0;
+  }
+
+  if (sname)
+  {
+    Daemon();
+    return 0;
+  }
+
+  if (fmindex || pattern)
+  {
+    decompress=1; // Only .bcm files in directories
+    batch=1;
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i)
+      Collect(argv[i], 1, files);
+
+    if (pattern)
+      return !Grep(files);
+
+    pool.Start(threads);
+    for (size_t i=0; i<files.size(); ++i)
+      BuildIndex(files[i].c_str());
+    pool.Stop();
+    return 0;
+  }
+
+  pool.Start(threads);
+
+  char ofname[FILENAME_MAX];
+  if (batch)
+  {
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i)
+      Collect(argv[i], 1, files);
+
+    for (size_t i=0; i<files.size(); ++i)
+    {
+      pool.Submit([i, &files]()
+      {
+        char name[FILENAME_MAX];
+        OutName(files[i].c_str(), name);
+        ProcessFile(files[i].c_str(), name);
+      });
+    }
+    pool.Drain();
+
+    fprintf(stderr, "%d files in %1.1f sec\n", int(files.size()),
+        std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+  }
+  else
+  {
+    if (argc<3)
+      OutName(argv[1], ofname);
+    else
+      strcpy(ofname, argv[2]);
+
+    ProcessFile(argv[1], ofname);
+  }
+
+  pool.Stop();
 
   return 0;
 }
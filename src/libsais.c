@@ -29,6 +29,12 @@ Please see the file LICENSE for full copyright information.
 
 #include "libsais.h"
 
+#if defined(__linux__) && !defined(NO_HUGEPAGES)
+    #include <sys/mman.h>
+
+    #define LIBSAIS_HUGE_PAGES
+#endif
+
 #define INT_BIT                         (32)
 #define ALPHABET_SIZE                   (1 << CHAR_BIT)
 #define SUFFIX_GROUP_BIT                (INT_BIT - 1)
@@ -79,8 +85,50 @@ static FORCEINLINE void * libsais_align_up(const void * address, size_t alignmen
     return (void *)((((intptr_t)address) + ((intptr_t)alignment) - 1) & (-((intptr_t)alignment)));
 }
 
+#if defined(LIBSAIS_HUGE_PAGES)
+
+#define LIBSAIS_HUGE_PAGE_SIZE          ((size_t)1 << 21)
+
+static void * libsais_huge_malloc(size_t size, size_t alignment)
+{
+    size_t header = alignment > 3 * sizeof(size_t) ? alignment : 3 * sizeof(size_t);
+    size_t length = (header + size + LIBSAIS_HUGE_PAGE_SIZE - 1) & (~(LIBSAIS_HUGE_PAGE_SIZE - 1));
+    void * address = MAP_FAILED;
+
+#if defined(USE_HUGETLB)
+    address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if (address == MAP_FAILED)
+    {
+        address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) { return NULL; }
+
+#if defined(MADV_HUGEPAGE)
+        madvise(address, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    void * aligned_address = libsais_align_up((void *)((intptr_t)address + (intptr_t)header), alignment);
+    ((size_t *)aligned_address)[-3] = (size_t)address;
+    ((size_t *)aligned_address)[-2] = length;
+    ((short *)aligned_address)[-1] = 0;
+
+    return aligned_address;
+}
+
+#endif
+
 static FORCEINLINE void * libsais_aligned_malloc(size_t size, size_t alignment)
 {
+#if defined(LIBSAIS_HUGE_PAGES)
+    if (size >= LIBSAIS_HUGE_PAGE_SIZE)
+    {
+        void * aligned_address = libsais_huge_malloc(size, alignment);
+        if (aligned_address != NULL) { return aligned_address; }
+    }
+#endif
+
     void * address = malloc(size + sizeof(short) + alignment - 1);
     if (address != NULL)
     {
@@ -97,10 +145,67 @@ static FORCEINLINE void libsais_aligned_free(void * aligned_address)
 {
     if (aligned_address != NULL)
     {
+#if defined(LIBSAIS_HUGE_PAGES)
+        if (((short *)aligned_address)[-1] == 0)
+        {
+            munmap((void *)((size_t *)aligned_address)[-3], ((size_t *)aligned_address)[-2]);
+            return;
+        }
+#endif
+
         free((void *)((intptr_t)aligned_address - ((short *)aligned_address)[-1]));
     }
 }
 
+typedef struct LIBSAIS_CONTEXT
+{
+    int *       buckets;
+    int *       buffer;
+    size_t      buffer_size;
+} LIBSAIS_CONTEXT;
+
+static LIBSAIS_CONTEXT * libsais_create_ctx_main(void)
+{
+    LIBSAIS_CONTEXT * RESTRICT ctx = (LIBSAIS_CONTEXT *)libsais_aligned_malloc(sizeof(LIBSAIS_CONTEXT), 64);
+    int * RESTRICT buckets = (int *)libsais_aligned_malloc(8 * ALPHABET_SIZE * sizeof(int), 4096);
+
+    if (ctx != NULL && buckets != NULL)
+    {
+        ctx->buckets        = buckets;
+        ctx->buffer         = NULL;
+        ctx->buffer_size    = 0;
+
+        return ctx;
+    }
+
+    libsais_aligned_free(buckets);
+    libsais_aligned_free(ctx);
+    return NULL;
+}
+
+static void libsais_free_ctx_main(LIBSAIS_CONTEXT * ctx)
+{
+    if (ctx != NULL)
+    {
+        libsais_aligned_free(ctx->buffer);
+        libsais_aligned_free(ctx->buckets);
+        libsais_aligned_free(ctx);
+    }
+}
+
+static int * libsais_ctx_buffer(LIBSAIS_CONTEXT * RESTRICT ctx, int k)
+{
+    if (ctx->buffer_size < (size_t)k)
+    {
+        libsais_aligned_free(ctx->buffer);
+
+        ctx->buffer         = (int *)libsais_aligned_malloc((size_t)k * sizeof(int), 4096);
+        ctx->buffer_size    = ctx->buffer != NULL ? (size_t)k : 0;
+    }
+
+    return ctx->buffer;
+}
+
 static int libsais_gather_lms_suffixes_8u(const unsigned char * RESTRICT T, int * RESTRICT SA, int n)
 {
     const ptrdiff_t prefetch_distance = 128;
@@ -1226,7 +1331,7 @@ static void libsais_induce_partial_order_32s_1k(const int * RESTRICT T, int * RE
     libsais_partial_sorting_gather_lms_suffixes_32s_1k(SA, n);
 }
 
-static int libsais_renumber_and_gather_lms_suffixes_8u(int * RESTRICT SA, int n, int m)
+static int libsais_renumber_and_gather_lms_suffixes_8u(int * RESTRICT SA, int n, int m, int fs)
 {
     const ptrdiff_t prefetch_distance = 32;
 
@@ -1258,7 +1363,7 @@ static int libsais_renumber_and_gather_lms_suffixes_8u(int * RESTRICT SA, int n,
     if (name < m)
     {
         ptrdiff_t l;
-        for (i = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 1, j = (ptrdiff_t)m + 3, l = (ptrdiff_t)n - 1; i >= j; i -= 4)
+        for (i = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 1, j = (ptrdiff_t)m + 3, l = (ptrdiff_t)n + (ptrdiff_t)fs - 1; i >= j; i -= 4)
         {
             libsais_prefetch(&SA[i - prefetch_distance]);
 
@@ -1976,7 +2081,7 @@ static void libsais_reconstruct_compacted_lms_suffixes_32s_1k(int * RESTRICT T,
     }
 }
 
-static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, int fs)
+static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, int fs, LIBSAIS_CONTEXT * RESTRICT ctx)
 {
     if (k > 0 && fs / k >= 6)
     {
@@ -2002,7 +2107,7 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
             {
                 int f = libsais_compact_lms_suffixes_32s(T, SA, n, m, fs);
 
-                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f) != 0)
+                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
                 {
                     return -2;
                 }
@@ -2050,7 +2155,7 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
             {
                 int f = libsais_compact_lms_suffixes_32s(T, SA, n, m, fs);
 
-                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f) != 0)
+                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
                 {
                     return -2;
                 }
@@ -2094,7 +2199,7 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
             {
                 int f = libsais_compact_lms_suffixes_32s(T, SA, n, m, fs);
 
-                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f) != 0)
+                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
                 {
                     return -2;
                 }
@@ -2121,7 +2226,7 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
     }
     else
     {
-        int * buffer = fs < k ? (int *)libsais_aligned_malloc((size_t)k * sizeof(int), 4096) : (int *)NULL;
+        int * buffer = fs < k ? libsais_ctx_buffer(ctx, k) : (int *)NULL;
 
         int alignment = fs - 1024 >= k ? 1024 : 16;
         int * RESTRICT buckets = fs - alignment >= k ? (int *)libsais_align_up(&SA[n + fs - k - alignment], (size_t)alignment * sizeof(int)) : fs >= k ? &SA[n + fs - k] : buffer;
@@ -2141,18 +2246,18 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
             int names = libsais_renumber_and_mark_distinct_lms_suffixes_32s_1k(T, SA, n, m);
             if (names < m)
             {
-                if (buffer != NULL) { libsais_aligned_free(buffer); buckets = NULL; }
+                if (buffer != NULL) { buckets = NULL; }
 
                 int f = libsais_compact_lms_suffixes_32s(T, SA, n, m, fs);
 
-                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f) != 0)
+                if (libsais_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
                 {
                     return -2;
                 }
 
                 libsais_reconstruct_compacted_lms_suffixes_32s_1k(T, SA, n, k, m, fs, f);
 
-                if (buckets == NULL) { buckets = buffer = (int *)libsais_aligned_malloc((size_t)k * sizeof(int), 4096); }
+                if (buckets == NULL) { buckets = buffer = libsais_ctx_buffer(ctx, k); }
                 if (buckets == NULL) { return -2; }
             }
             
@@ -2162,58 +2267,48 @@ static int libsais_main_32s(int * RESTRICT T, int * RESTRICT SA, int n, int k, i
         }
 
         libsais_induce_final_order_32s_1k(T, SA, n, k, buckets);
-        libsais_aligned_free(buffer);
 
         return 0;
     }
 }
 
-static int libsais_main_8u(const unsigned char * T, int * SA, int n, int bwt)
+static int libsais_main_8u(const unsigned char * T, int * SA, int n, int bwt, int fs, LIBSAIS_CONTEXT * RESTRICT ctx)
 {
-    int * RESTRICT buckets = (int *)libsais_aligned_malloc(8 * ALPHABET_SIZE * sizeof(int), 4096);
+    int * RESTRICT buckets = ctx->buckets;
 
-    if (buckets != NULL)
-    {
-        int m = libsais_count_and_gather_lms_suffixes_8u(T, SA, n, buckets);
+    int m = libsais_count_and_gather_lms_suffixes_8u(T, SA, n, buckets);
 
-        libsais_initialize_buckets_start_and_end_8u(buckets);
+    libsais_initialize_buckets_start_and_end_8u(buckets);
 
-        if (m > 0)
-        {
-            int first_lms_suffix    = SA[n - m];
-            int left_suffixes_count = libsais_initialize_buckets_for_lms_suffixes_radix_sort_8u(T, buckets, first_lms_suffix);
+    if (m > 0)
+    {
+        int first_lms_suffix    = SA[n - m];
+        int left_suffixes_count = libsais_initialize_buckets_for_lms_suffixes_radix_sort_8u(T, buckets, first_lms_suffix);
 
-            libsais_radix_sort_lms_suffixes_8u(T, SA, n, m, buckets);
-            libsais_initialize_buckets_for_partial_sorting_8u(T, buckets, first_lms_suffix, left_suffixes_count);
-            libsais_induce_partial_order_8u(T, SA, n, buckets, first_lms_suffix, left_suffixes_count);
+        libsais_radix_sort_lms_suffixes_8u(T, SA, n, m, buckets);
+        libsais_initialize_buckets_for_partial_sorting_8u(T, buckets, first_lms_suffix, left_suffixes_count);
+        libsais_induce_partial_order_8u(T, SA, n, buckets, first_lms_suffix, left_suffixes_count);
 
-            int names = libsais_renumber_and_gather_lms_suffixes_8u(SA, n, m);
-            if (names < m)
+        int names = libsais_renumber_and_gather_lms_suffixes_8u(SA, n, m, fs);
+        if (names < m)
+        {
+            if (libsais_main_32s(SA + n + fs - m, SA, m, names, fs + n - 2 * m, ctx) != 0)
             {
-                if (libsais_main_32s(SA + n - m, SA, m, names, n - 2 * m) != 0)
-                {
-                    libsais_aligned_free(buckets);
-                    return -2;
-                }
-
-                libsais_gather_lms_suffixes_8u(T, SA, n);
-                libsais_reconstruct_lms_suffixes(SA, n, m);
+                return -2;
             }
 
-            libsais_place_lms_suffixes_interval_8u(SA, n, m, buckets);
+            libsais_gather_lms_suffixes_8u(T, SA, n);
+            libsais_reconstruct_lms_suffixes(SA, n, m);
         }
-        else
-        {
-            memset(SA, 0, (size_t)n * sizeof(int));
-        }
-
-        int index = libsais_induce_final_order_8u(T, SA, n, bwt, buckets);
 
-        libsais_aligned_free(buckets);
-        return index;
+        libsais_place_lms_suffixes_interval_8u(SA, n, m, buckets);
+    }
+    else
+    {
+        memset(SA, 0, (size_t)n * sizeof(int));
     }
 
-    return -2;
+    return libsais_induce_final_order_8u(T, SA, n, bwt, buckets);
 }
 
 static void libsais_bwt_copy_8u(unsigned char * RESTRICT U, int * RESTRICT A, int n)
@@ -2241,9 +2336,37 @@ static void libsais_bwt_copy_8u(unsigned char * RESTRICT U, int * RESTRICT A, in
     }
 }
 
+void * libsais_create_ctx(void)
+{
+    return (void *)libsais_create_ctx_main();
+}
+
+void libsais_free_ctx(void * ctx)
+{
+    libsais_free_ctx_main((LIBSAIS_CONTEXT *)ctx);
+}
+
 int libsais(const unsigned char * T, int * SA, int n)
 {
-    if ((T == NULL) || (SA == NULL) || (n < 0))
+    LIBSAIS_CONTEXT * ctx = libsais_create_ctx_main();
+    int index = ctx != NULL ? libsais_ctx(ctx, T, SA, n, 0) : -2;
+
+    libsais_free_ctx_main(ctx);
+    return index;
+}
+
+int libsais_bwt(const unsigned char * T, unsigned char * U, int * A, int n)
+{
+    LIBSAIS_CONTEXT * ctx = libsais_create_ctx_main();
+    int index = ctx != NULL ? libsais_bwt_ctx(ctx, T, U, A, n, 0) : -2;
+
+    libsais_free_ctx_main(ctx);
+    return index;
+}
+
+int libsais_ctx(void * ctx, const unsigned char * T, int * SA, int n, int fs)
+{
+    if ((ctx == NULL) || (T == NULL) || (SA == NULL) || (n < 0) || (fs < 0))
     {
         return -1;
     }
@@ -2253,12 +2376,12 @@ int libsais(const unsigned char * T, int * SA, int n)
         return 0;
     }
 
-    return libsais_main_8u(T, SA, n, 0);
+    return libsais_main_8u(T, SA, n, 0, fs, (LIBSAIS_CONTEXT *)ctx);
 }
 
-int libsais_bwt(const unsigned char * T, unsigned char * U, int * A, int n)
+int libsais_bwt_ctx(void * ctx, const unsigned char * T, unsigned char * U, int * A, int n, int fs)
 {
-    if ((T == NULL) || (U == NULL) || (A == NULL) || (n < 0)) 
+    if ((ctx == NULL) || (T == NULL) || (U == NULL) || (A == NULL) || (n < 0) || (fs < 0)) 
     { 
         return -1; 
     }
@@ -2268,7 +2391,7 @@ int libsais_bwt(const unsigned char * T, unsigned char * U, int * A, int n)
         return n; 
     }
 
-    int index = libsais_main_8u(T, A, n, 1);
+    int index = libsais_main_8u(T, A, n, 1, fs, (LIBSAIS_CONTEXT *)ctx);
     if (index >= 0) 
     { 
         U[0] = T[n - 1];
@@ -47,6 +47,42 @@ extern "C" {
     */
     int libsais_bwt(const unsigned char * T, unsigned char * U, int * A, int n);
 
+    /**
+    * Creates the libsais context that allows reusing allocated memory with each libsais operation.
+    * One context must not be used by several threads at the same time.
+    * @return The libsais context, NULL otherwise.
+    */
+    void * libsais_create_ctx(void);
+
+    /**
+    * Destroys the libsais context and frees previously allocated memory.
+    * @param ctx The libsais context (can be NULL).
+    */
+    void libsais_free_ctx(void * ctx);
+
+    /**
+    * Constructs the suffix array of a given string using libsais context.
+    * @param ctx The libsais context.
+    * @param T [0..n-1] The input string.
+    * @param SA [0..n-1+fs] The output array of suffixes.
+    * @param n The length of the given string.
+    * @param fs The extra space available at the end of SA array (can be 0).
+    * @return 0 if no error occurred, -1 or -2 otherwise.
+    */
+    int libsais_ctx(void * ctx, const unsigned char * T, int * SA, int n, int fs);
+
+    /**
+    * Constructs the burrows-wheeler transformed string of a given string using libsais context.
+    * @param ctx The libsais context.
+    * @param T [0..n-1] The input string.
+    * @param U [0..n-1] The output string. (can be T)
+    * @param A [0..n-1+fs] The temporary array.
+    * @param n The length of the given string.
+    * @param fs The extra space available at the end of A array (can be 0).
+    * @return The primary index if no error occurred, -1 or -2 otherwise.
+    */
+    int libsais_bwt_ctx(void * ctx, const unsigned char * T, unsigned char * U, int * A, int n, int fs);
+
 #ifdef __cplusplus
 }
 #endif
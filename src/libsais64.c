@@ -0,0 +1,2410 @@
+/*--
+
+This file is a part of libsais, a library for linear time
+suffix array and burrows wheeler transform construction.
+
+   Copyright (c) 2021 Ilya Grebnov <ilya.grebnov@gmail.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+Please see the file LICENSE for full copyright information.
+
+--*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "libsais64.h"
+
+typedef int64_t                 sa_sint_t;
+typedef uint64_t                sa_uint_t;
+
+#if defined(__linux__) && !defined(NO_HUGEPAGES)
+    #include <sys/mman.h>
+
+    #define LIBSAIS64_HUGE_PAGES
+#endif
+
+#define SAINT_BIT                       (64)
+#define SAINT_MAX                       INT64_MAX
+#define SAINT_MIN                       INT64_MIN
+#define ALPHABET_SIZE                   (1 << CHAR_BIT)
+#define SUFFIX_GROUP_BIT                (SAINT_BIT - 1)
+#define SUFFIX_GROUP_MARKER             (((sa_sint_t)1) << (SUFFIX_GROUP_BIT - 1))
+
+#define BUCKETS_INDEX2(_c, _s)          (((_c) << 1) + (_s))
+#define BUCKETS_INDEX4(_c, _s)          (((_c) << 2) + (_s))
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define RESTRICT __restrict__
+    #define FORCEINLINE inline __attribute__((__always_inline__))
+#elif defined(_MSC_VER) || defined(__INTEL_COMPILER)
+    #define RESTRICT __restrict
+    #define FORCEINLINE __forceinline
+#else
+    #error Your compiler, configuration or platform is not supported.
+#endif
+
+#if defined(__has_builtin)
+    #if __has_builtin(__builtin_prefetch)
+        #define HAS_BUILTIN_PREFECTCH
+    #endif
+#elif defined(__GNUC__) && __GNUC__ > 3
+    #define HAS_BUILTIN_PREFECTCH
+#endif 
+
+#if defined(HAS_BUILTIN_PREFECTCH)
+    #define libsais64_prefetch(address) __builtin_prefetch((const void *)(address), 0, 0)
+    #define libsais64_prefetchw(address) __builtin_prefetch((const void *)(address), 1, 0)
+#elif defined (_M_IX86) || defined (_M_AMD64)
+    #include <intrin.h>
+    #define libsais64_prefetch(address) _mm_prefetch((const void *)(address), _MM_HINT_NTA)
+    #define libsais64_prefetchw(address) _m_prefetchw((const void *)(address))
+#elif defined (_M_ARM)
+    #include <intrin.h>
+    #define libsais64_prefetch(address) __prefetch((const void *)(address))
+    #define libsais64_prefetchw(address) __prefetchw((const void *)(address))
+#elif defined (_M_ARM64)
+    #include <intrin.h>
+    #define libsais64_prefetch(address) __prefetch2((const void *)(address), 1)
+    #define libsais64_prefetchw(address) __prefetch2((const void *)(address), 17)
+#else
+    #error Your compiler, configuration or platform is not supported.
+#endif
+
+static FORCEINLINE void * libsais64_align_up(const void * address, size_t alignment)
+{
+    return (void *)((((intptr_t)address) + ((intptr_t)alignment) - 1) & (-((intptr_t)alignment)));
+}
+
+#if defined(LIBSAIS64_HUGE_PAGES)
+
+#define LIBSAIS64_HUGE_PAGE_SIZE        ((size_t)1 << 21)
+
+static void * libsais64_huge_malloc(size_t size, size_t alignment)
+{
+    size_t header = alignment > 3 * sizeof(size_t) ? alignment : 3 * sizeof(size_t);
+    size_t length = (header + size + LIBSAIS64_HUGE_PAGE_SIZE - 1) & (~(LIBSAIS64_HUGE_PAGE_SIZE - 1));
+    void * address = MAP_FAILED;
+
+#if defined(USE_HUGETLB)
+    address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if (address == MAP_FAILED)
+    {
+        address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) { return NULL; }
+
+#if defined(MADV_HUGEPAGE)
+        madvise(address, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    void * aligned_address = libsais64_align_up((void *)((intptr_t)address + (intptr_t)header), alignment);
+    ((size_t *)aligned_address)[-3] = (size_t)address;
+    ((size_t *)aligned_address)[-2] = length;
+    ((short *)aligned_address)[-1] = 0;
+
+    return aligned_address;
+}
+
+#endif
+
+static FORCEINLINE void * libsais64_aligned_malloc(size_t size, size_t alignment)
+{
+#if defined(LIBSAIS64_HUGE_PAGES)
+    if (size >= LIBSAIS64_HUGE_PAGE_SIZE)
+    {
+        void * aligned_address = libsais64_huge_malloc(size, alignment);
+        if (aligned_address != NULL) { return aligned_address; }
+    }
+#endif
+
+    void * address = malloc(size + sizeof(short) + alignment - 1);
+    if (address != NULL)
+    {
+        void * aligned_address = libsais64_align_up((void *)((intptr_t)address + (intptr_t)(sizeof(short))), alignment);
+        ((short *)aligned_address)[-1] = (short)((intptr_t)aligned_address - (intptr_t)address);
+
+        return aligned_address;
+    }
+
+    return NULL;
+}
+
+static FORCEINLINE void libsais64_aligned_free(void * aligned_address)
+{
+    if (aligned_address != NULL)
+    {
+#if defined(LIBSAIS64_HUGE_PAGES)
+        if (((short *)aligned_address)[-1] == 0)
+        {
+            munmap((void *)((size_t *)aligned_address)[-3], ((size_t *)aligned_address)[-2]);
+            return;
+        }
+#endif
+
+        free((void *)((intptr_t)aligned_address - ((short *)aligned_address)[-1]));
+    }
+}
+
+typedef struct LIBSAIS64_CONTEXT
+{
+    sa_sint_t *       buckets;
+    sa_sint_t *       buffer;
+    size_t      buffer_size;
+} LIBSAIS64_CONTEXT;
+
+static LIBSAIS64_CONTEXT * libsais64_create_ctx_main(void)
+{
+    LIBSAIS64_CONTEXT * RESTRICT ctx = (LIBSAIS64_CONTEXT *)libsais64_aligned_malloc(sizeof(LIBSAIS64_CONTEXT), 64);
+    sa_sint_t * RESTRICT buckets = (sa_sint_t *)libsais64_aligned_malloc(8 * ALPHABET_SIZE * sizeof(sa_sint_t), 4096);
+
+    if (ctx != NULL && buckets != NULL)
+    {
+        ctx->buckets        = buckets;
+        ctx->buffer         = NULL;
+        ctx->buffer_size    = 0;
+
+        return ctx;
+    }
+
+    libsais64_aligned_free(buckets);
+    libsais64_aligned_free(ctx);
+    return NULL;
+}
+
+static void libsais64_free_ctx_main(LIBSAIS64_CONTEXT * ctx)
+{
+    if (ctx != NULL)
+    {
+        libsais64_aligned_free(ctx->buffer);
+        libsais64_aligned_free(ctx->buckets);
+        libsais64_aligned_free(ctx);
+    }
+}
+
+static sa_sint_t * libsais64_ctx_buffer(LIBSAIS64_CONTEXT * RESTRICT ctx, sa_sint_t k)
+{
+    if (ctx->buffer_size < (size_t)k)
+    {
+        libsais64_aligned_free(ctx->buffer);
+
+        ctx->buffer         = (sa_sint_t *)libsais64_aligned_malloc((size_t)k * sizeof(sa_sint_t), 4096);
+        ctx->buffer_size    = ctx->buffer != NULL ? (size_t)k : 0;
+    }
+
+    return ctx->buffer;
+}
+
+static sa_sint_t libsais64_gather_lms_suffixes_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 128;
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - prefetch_distance]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((s & 3) == 1);
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((s & 3) == 1);
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((s & 3) == 1);
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+    }
+
+    return n - 1 - m;
+}
+
+static sa_sint_t libsais64_gather_lms_suffixes_32s(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - prefetch_distance]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((s & 3) == 1);
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((s & 3) == 1);
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((s & 3) == 1);
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+    }
+
+    return n - 1 - m;
+}
+
+static sa_sint_t libsais64_gather_compacted_lms_suffixes_32s(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - prefetch_distance]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((ptrdiff_t)(s & 3) == (c0 >= 0));
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((ptrdiff_t)(s & 3) == (c0 >= 0));
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+    }
+
+    return n - 1 - m;
+}
+
+static void libsais64_count_lms_suffixes_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    memset(buckets, 0, 2 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t             i   = n - 2;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 0], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 1], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 2], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 3], 0)]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1)));
+        buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1)));
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1)));
+        buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1)));
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1)));
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    buckets[BUCKETS_INDEX2((size_t)c0, 0)]++;
+}
+
+static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 128;
+
+    memset(buckets, 0, 4 * ALPHABET_SIZE * sizeof(sa_sint_t));
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - prefetch_distance]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c0, s & 3)]++;
+
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c0, s & 3)]++;
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+    }
+
+    buckets[BUCKETS_INDEX4((size_t)c0, (s << 1) & 3)]++;
+
+    return n - 1 - m;
+}
+
+static sa_sint_t libsais64_count_and_gather_lms_suffixes_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    memset(buckets, 0, 4 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX4(T[i - prefetch_distance - 0], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX4(T[i - prefetch_distance - 1], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX4(T[i - prefetch_distance - 2], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX4(T[i - prefetch_distance - 3], 0)]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c0, s & 3)]++;
+
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c0, s & 3)]++;
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]++;
+    }
+
+    buckets[BUCKETS_INDEX4((size_t)c0, (s << 1) & 3)]++;
+
+    return n - 1 - m;
+}
+
+static sa_sint_t libsais64_count_and_gather_lms_suffixes_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    memset(buckets, 0, 2 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 0], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 1], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 2], 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 3], 0)]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((s & 3) == 1);
+        buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    buckets[BUCKETS_INDEX2((size_t)c0, 0)]++;
+
+    return n - 1 - m;
+}
+
+static sa_sint_t libsais64_count_and_gather_compacted_lms_suffixes_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    memset(buckets, 0, 2 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t             i   = n - 2;
+    sa_sint_t             m   = n - 1;
+    size_t          s   = 1;
+    ptrdiff_t       c0  = T[n - 1];
+    ptrdiff_t       c1  = 0;
+
+    for (; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 0] & SAINT_MAX, 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 1] & SAINT_MAX, 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 2] & SAINT_MAX, 0)]);
+        libsais64_prefetchw(&buckets[BUCKETS_INDEX2(T[i - prefetch_distance - 3] & SAINT_MAX, 0)]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((ptrdiff_t)(s & 3) == (c0 >=0));
+        c0 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 0; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+        c1 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); SA[m] = i - 1; m -= ((ptrdiff_t)(s & 3) == (c0 >= 0));
+        c0 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c0, (s & 3) == 1)]++;
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i - 2; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+        c1 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); SA[m] = i + 1; m -= ((ptrdiff_t)(s & 3) == (c1 >= 0));
+        c1 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c1, (s & 3) == 1)]++;
+    }
+
+    c0 &= SAINT_MAX; buckets[BUCKETS_INDEX2((size_t)c0, 0)]++;
+
+    return n - 1 - m;
+}
+
+static void libsais64_count_suffixes_32s(const sa_sint_t * RESTRICT T, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    memset(buckets, 0, (size_t)k * sizeof(sa_sint_t));
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - 7; i < j; i += 8)
+    {
+        libsais64_prefetch(&T[i + prefetch_distance]);
+
+        buckets[T[i + 0]]++;
+        buckets[T[i + 1]]++;
+        buckets[T[i + 2]]++;
+        buckets[T[i + 3]]++;
+        buckets[T[i + 4]]++;
+        buckets[T[i + 5]]++;
+        buckets[T[i + 6]]++;
+        buckets[T[i + 7]]++;
+    }
+
+    for (j += 7; i < j; i += 1)
+    {
+        buckets[T[i]]++;
+    }
+}
+
+static void libsais64_initialize_buckets_start_and_end_8u(sa_sint_t * RESTRICT buckets)
+{
+    sa_sint_t * RESTRICT bucket_start = &buckets[6 * ALPHABET_SIZE];
+    sa_sint_t * RESTRICT bucket_end   = &buckets[7 * ALPHABET_SIZE];
+
+    ptrdiff_t i, j; sa_sint_t sum = 0;
+    for (i = BUCKETS_INDEX4(0, 0), j = 0; i <= BUCKETS_INDEX4(UCHAR_MAX, 0); i += BUCKETS_INDEX4(1, 0), j += 1)
+    {
+        bucket_start[j] = sum;
+        sum += buckets[i + BUCKETS_INDEX4(0, 0)] + buckets[i + BUCKETS_INDEX4(0, 1)] + buckets[i + BUCKETS_INDEX4(0, 2)] + buckets[i + BUCKETS_INDEX4(0, 3)];
+        bucket_end[j] = sum;
+    }
+}
+
+static void libsais64_initialize_buckets_start_and_end_32s_6k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    sa_sint_t * RESTRICT bucket_start = &buckets[4 * k];
+    sa_sint_t * RESTRICT bucket_end   = &buckets[5 * k];
+
+    ptrdiff_t i, j; sa_sint_t sum = 0;
+    for (i = BUCKETS_INDEX4(0, 0), j = 0; i <= BUCKETS_INDEX4((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX4(1, 0), j += 1)
+    {
+        bucket_start[j] = sum;
+        sum += buckets[i + BUCKETS_INDEX4(0, 0)] + buckets[i + BUCKETS_INDEX4(0, 1)] + buckets[i + BUCKETS_INDEX4(0, 2)] + buckets[i + BUCKETS_INDEX4(0, 3)];
+        bucket_end[j] = sum;
+    }
+}
+
+static void libsais64_initialize_buckets_start_and_end_32s_4k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    sa_sint_t * RESTRICT bucket_start = &buckets[2 * k];
+    sa_sint_t * RESTRICT bucket_end   = &buckets[3 * k];
+
+    ptrdiff_t i, j; sa_sint_t sum = 0;
+    for (i = BUCKETS_INDEX2(0, 0), j = 0; i <= BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX2(1, 0), j += 1)
+    { 
+        bucket_start[j] = sum;
+        sum += buckets[i + BUCKETS_INDEX2(0, 0)] + buckets[i + BUCKETS_INDEX2(0, 1)];
+        bucket_end[j] = sum;
+    }
+}
+
+static void libsais64_initialize_buckets_end_32s_2k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t i; sa_sint_t sum0 = 0;
+    for (i = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX2(1, 0))
+    { 
+        sum0 += buckets[i + BUCKETS_INDEX2(0, 0)] + buckets[i + BUCKETS_INDEX2(0, 1)]; buckets[i + BUCKETS_INDEX2(0, 0)] = sum0;
+    }
+}
+
+static void libsais64_initialize_buckets_start_32s_1k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t i; sa_sint_t sum = 0;
+    for (i = 0; i <= (ptrdiff_t)k - 1; i += 1) { sa_sint_t tmp = buckets[i]; buckets[i] = sum; sum += tmp; }
+}
+
+static void libsais64_initialize_buckets_end_32s_1k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t i; sa_sint_t sum = 0;
+    for (i = 0; i <= (ptrdiff_t)k - 1; i += 1) { sum += buckets[i]; buckets[i] = sum; }
+}
+
+static void libsais64_initialize_buckets_start_and_end_32s_2k(sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t i, j;
+    for (i = BUCKETS_INDEX2(0, 0), j = 0; i <= BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX2(1, 0), j += 1)
+    {
+        buckets[j] = buckets[i];
+    }
+
+    buckets[k] = 0; memcpy(&buckets[k + 1], buckets, ((size_t)k - 1) * sizeof(sa_sint_t));
+}
+
+static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
+{
+    {
+        size_t      s = 0;
+        ptrdiff_t   c0 = T[first_lms_suffix];
+        ptrdiff_t   c1 = 0;
+
+        for (; --first_lms_suffix >= 0; )
+        {
+            c1 = c0; c0 = T[first_lms_suffix]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1)));
+            buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]--;
+        }
+
+        buckets[BUCKETS_INDEX4((size_t)c0, (s << 1) & 3)]--;
+    }
+
+    {
+        sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+
+        ptrdiff_t i, j; sa_sint_t sum = 0;
+        for (i = BUCKETS_INDEX4(0, 0), j = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX4(UCHAR_MAX, 0); i += BUCKETS_INDEX4(1, 0), j += BUCKETS_INDEX2(1, 0))
+        { 
+            temp_bucket[j + BUCKETS_INDEX2(0, 1)] = sum; sum += buckets[i + BUCKETS_INDEX4(0, 1)] + buckets[i + BUCKETS_INDEX4(0, 3)]; temp_bucket[j] = sum;
+        }
+
+        return sum;
+    }
+}
+
+static void libsais64_initialize_buckets_for_lms_suffixes_radix_sort_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
+{
+    buckets[BUCKETS_INDEX2(T[first_lms_suffix], 0)]++;
+    buckets[BUCKETS_INDEX2(T[first_lms_suffix], 1)]--;
+
+    ptrdiff_t i; sa_sint_t sum0 = 0, sum1 = 0;
+    for (i = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX2(1, 0))
+    { 
+        sum0 += buckets[i + BUCKETS_INDEX2(0, 0)] + buckets[i + BUCKETS_INDEX2(0, 1)];
+        sum1 += buckets[i + BUCKETS_INDEX2(0, 1)];
+        
+        buckets[i + BUCKETS_INDEX2(0, 0)] = sum0;
+        buckets[i + BUCKETS_INDEX2(0, 1)] = sum1;
+    }
+}
+
+static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
+{
+    {
+        size_t      s = 0;
+        ptrdiff_t   c0 = T[first_lms_suffix];
+        ptrdiff_t   c1 = 0;
+
+        for (; --first_lms_suffix >= 0; )
+        {
+            c1 = c0; c0 = T[first_lms_suffix]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1)));
+            buckets[BUCKETS_INDEX4((size_t)c1, s & 3)]--;
+        }
+
+        buckets[BUCKETS_INDEX4((size_t)c0, (s << 1) & 3)]--;
+    }
+
+    {
+        sa_sint_t * RESTRICT temp_bucket = &buckets[4 * k];
+
+        ptrdiff_t i, j; sa_sint_t sum = 0;
+        for (i = BUCKETS_INDEX4(0, 0), j = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX4((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX4(1, 0), j += BUCKETS_INDEX2(1, 0))
+        { 
+            temp_bucket[j + BUCKETS_INDEX2(0, 1)] = sum; sum += buckets[i + BUCKETS_INDEX4(0, 1)] + buckets[i + BUCKETS_INDEX4(0, 3)]; temp_bucket[j] = sum;
+        }
+
+        return sum;
+    }
+}
+
+static void libsais64_initialize_buckets_for_radix_and_partial_sorting_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
+{
+    sa_sint_t * RESTRICT bucket_start = &buckets[2 * k];
+    sa_sint_t * RESTRICT bucket_end   = &buckets[3 * k];
+
+    buckets[BUCKETS_INDEX2(T[first_lms_suffix], 0)]++;
+    buckets[BUCKETS_INDEX2(T[first_lms_suffix], 1)]--;
+
+    ptrdiff_t i, j; sa_sint_t sum0 = 0, sum1 = 0;
+    for (i = BUCKETS_INDEX2(0, 0), j = 0; i <= BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX2(1, 0), j += 1)
+    { 
+        bucket_start[j] = sum1;
+
+        sum0 += buckets[i + BUCKETS_INDEX2(0, 1)];
+        sum1 += buckets[i + BUCKETS_INDEX2(0, 0)] + buckets[i + BUCKETS_INDEX2(0, 1)];
+        buckets[i + BUCKETS_INDEX2(0, 1)] = sum0;
+
+        bucket_end[j] = sum1;
+    }
+}
+
+static void libsais64_radix_sort_lms_suffixes_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
+
+    ptrdiff_t i, j;
+    for (i = (ptrdiff_t)n - 1, j = (ptrdiff_t)n - (ptrdiff_t)m + prefetch_distance + 3; i > j; i -= 4)
+    {
+        libsais64_prefetch(&SA[i - 2 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 0]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 1]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 2]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 3]]);
+
+        sa_sint_t p0 = SA[i - 0]; SA[--induction_bucket[BUCKETS_INDEX2(T[p0], 0)]] = p0;
+        sa_sint_t p1 = SA[i - 1]; SA[--induction_bucket[BUCKETS_INDEX2(T[p1], 0)]] = p1;
+        sa_sint_t p2 = SA[i - 2]; SA[--induction_bucket[BUCKETS_INDEX2(T[p2], 0)]] = p2;
+        sa_sint_t p3 = SA[i - 3]; SA[--induction_bucket[BUCKETS_INDEX2(T[p3], 0)]] = p3;
+    }
+
+    for (j -= prefetch_distance + 3; i > j; i -= 1)
+    {
+        sa_sint_t p = SA[i]; SA[--induction_bucket[BUCKETS_INDEX2(T[p], 0)]] = p;
+    }
+}
+
+static void libsais64_radix_sort_lms_suffixes_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t * RESTRICT induction_bucket)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i, j;
+    for (i = (ptrdiff_t)n - 1, j = (ptrdiff_t)n - (ptrdiff_t)m + 2 * prefetch_distance + 3; i > j; i -= 4)
+    {
+        libsais64_prefetch(&SA[i - 3 * prefetch_distance]);
+        
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 0]]);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 1]]);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 2]]);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 3]]);
+
+        libsais64_prefetchw(&induction_bucket[BUCKETS_INDEX2(T[SA[i - prefetch_distance - 0]], 0)]);
+        libsais64_prefetchw(&induction_bucket[BUCKETS_INDEX2(T[SA[i - prefetch_distance - 1]], 0)]);
+        libsais64_prefetchw(&induction_bucket[BUCKETS_INDEX2(T[SA[i - prefetch_distance - 2]], 0)]);
+        libsais64_prefetchw(&induction_bucket[BUCKETS_INDEX2(T[SA[i - prefetch_distance - 3]], 0)]);
+
+        sa_sint_t p0 = SA[i - 0]; SA[--induction_bucket[BUCKETS_INDEX2(T[p0], 0)]] = p0;
+        sa_sint_t p1 = SA[i - 1]; SA[--induction_bucket[BUCKETS_INDEX2(T[p1], 0)]] = p1;
+        sa_sint_t p2 = SA[i - 2]; SA[--induction_bucket[BUCKETS_INDEX2(T[p2], 0)]] = p2;
+        sa_sint_t p3 = SA[i - 3]; SA[--induction_bucket[BUCKETS_INDEX2(T[p3], 0)]] = p3;
+    }
+
+    for (j -= 2 * prefetch_distance + 3; i > j; i -= 1)
+    {
+        sa_sint_t p = SA[i]; SA[--induction_bucket[BUCKETS_INDEX2(T[p], 0)]] = p;
+    }
+}
+
+static sa_sint_t libsais64_radix_sort_lms_suffixes_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t             i = n - 2;
+    sa_sint_t             m = 0;
+    size_t          s = 1;
+    ptrdiff_t       c0 = T[n - 1];
+    ptrdiff_t       c1 = 0;
+    ptrdiff_t       c2 = 0;
+
+    for (; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&T[i - 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&buckets[T[i - prefetch_distance - 0]]);
+        libsais64_prefetchw(&buckets[T[i - prefetch_distance - 1]]);
+        libsais64_prefetchw(&buckets[T[i - prefetch_distance - 2]]);
+        libsais64_prefetchw(&buckets[T[i - prefetch_distance - 3]]);
+
+        c1 = T[i - 0]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); 
+        if ((s & 3) == 1) { SA[--buckets[c2 = c0]] = i + 1; m++; }
+        
+        c0 = T[i - 1]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); 
+        if ((s & 3) == 1) { SA[--buckets[c2 = c1]] = i - 0; m++; }
+
+        c1 = T[i - 2]; s = (s << 1) + (size_t)(c1 > (c0 - (ptrdiff_t)(s & 1))); 
+        if ((s & 3) == 1) { SA[--buckets[c2 = c0]] = i - 1; m++; }
+
+        c0 = T[i - 3]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); 
+        if ((s & 3) == 1) { SA[--buckets[c2 = c1]] = i - 2; m++; }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        c1 = c0; c0 = T[i]; s = (s << 1) + (size_t)(c0 > (c1 - (ptrdiff_t)(s & 1))); 
+        if ((s & 3) == 1) { SA[--buckets[c2 = c1]] = i + 1; m++; }
+    }
+
+    if (m > 1)
+    {
+        SA[buckets[c2]] = 0;
+    }
+
+    return m;
+}
+
+static void libsais64_radix_sort_set_markers_32s(sa_sint_t * RESTRICT SA, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket, sa_sint_t marker)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)k - 1 - prefetch_distance - 3; i < j; i += 4)
+    {
+        libsais64_prefetch(&induction_bucket[BUCKETS_INDEX2(i + 2 * prefetch_distance, 0)]);
+
+        libsais64_prefetchw(&SA[induction_bucket[BUCKETS_INDEX2(i + prefetch_distance + 0, 0)]]);
+        libsais64_prefetchw(&SA[induction_bucket[BUCKETS_INDEX2(i + prefetch_distance + 1, 0)]]);
+        libsais64_prefetchw(&SA[induction_bucket[BUCKETS_INDEX2(i + prefetch_distance + 2, 0)]]);
+        libsais64_prefetchw(&SA[induction_bucket[BUCKETS_INDEX2(i + prefetch_distance + 3, 0)]]);
+
+        SA[induction_bucket[BUCKETS_INDEX2(i + 0, 0)]] |= marker;
+        SA[induction_bucket[BUCKETS_INDEX2(i + 1, 0)]] |= marker;
+        SA[induction_bucket[BUCKETS_INDEX2(i + 2, 0)]] |= marker;
+        SA[induction_bucket[BUCKETS_INDEX2(i + 3, 0)]] |= marker;
+    }
+
+    for (j += prefetch_distance + 3; i < j; i += 1)
+    {
+        SA[induction_bucket[BUCKETS_INDEX2(i, 0)]] |= marker;
+    }
+}
+
+static void libsais64_initialize_buckets_for_partial_sorting_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+{
+    sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+
+    buckets[BUCKETS_INDEX4((size_t)T[first_lms_suffix], 1)]++;
+
+    ptrdiff_t i, j; sa_sint_t sum0 = left_suffixes_count + 1, sum1 = 0;
+    for (i = BUCKETS_INDEX4(0, 0), j = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX4(UCHAR_MAX, 0); i += BUCKETS_INDEX4(1, 0), j += BUCKETS_INDEX2(1, 0))
+    { 
+        temp_bucket[j + BUCKETS_INDEX2(0, 0)] = sum0;
+
+        sum0 += buckets[i + BUCKETS_INDEX4(0, 0)] + buckets[i + BUCKETS_INDEX4(0, 2)];
+        sum1 += buckets[i + BUCKETS_INDEX4(0, 1)];
+
+        buckets[j + BUCKETS_INDEX2(0, 0)] = sum0;
+        buckets[j + BUCKETS_INDEX2(0, 1)] = sum1;
+    }
+}
+
+static void libsais64_initialize_buckets_for_partial_sorting_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+{
+    sa_sint_t * RESTRICT temp_bucket = &buckets[4 * k];
+
+    buckets[BUCKETS_INDEX4((size_t)T[first_lms_suffix], 1)]++;
+
+    ptrdiff_t i, j; sa_sint_t sum0 = left_suffixes_count + 1, sum1 = 0;
+    for (i = BUCKETS_INDEX4(0, 0), j = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX4((ptrdiff_t)k - 1, 0); i += BUCKETS_INDEX4(1, 0), j += BUCKETS_INDEX2(1, 0))
+    { 
+        temp_bucket[j + BUCKETS_INDEX2(0, 0)] = sum0;
+
+        sum0 += buckets[i + BUCKETS_INDEX4(0, 0)] + buckets[i + BUCKETS_INDEX4(0, 2)];
+        sum1 += buckets[i + BUCKETS_INDEX4(0, 1)];
+
+        buckets[j + BUCKETS_INDEX2(0, 0)] = sum0;
+        buckets[j + BUCKETS_INDEX2(0, 1)] = sum1;
+    }
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets, sa_sint_t left_suffixes_count, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
+
+    SA[induction_bucket[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])]++] = (n - 1) | SAINT_MIN;
+    distinct_names[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])] = ++d;
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)left_suffixes_count - prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetch(&SA[i + 2 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i + prefetch_distance + 0] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i + prefetch_distance + 0] & SAINT_MAX] - 2);
+        libsais64_prefetch(&T[SA[i + prefetch_distance + 1] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i + prefetch_distance + 1] & SAINT_MAX] - 2);
+
+        sa_sint_t p0 = SA[i + 0]; d += (p0 < 0); p0 &= SAINT_MAX; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - 1], T[p0 - 2] >= T[p0 - 1]);
+        SA[induction_bucket[v0]++] = (p0 - 1) | ((sa_sint_t)(distinct_names[v0] != d) << (SAINT_BIT - 1)); distinct_names[v0] = d;
+
+        sa_sint_t p1 = SA[i + 1]; d += (p1 < 0); p1 &= SAINT_MAX; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - 1], T[p1 - 2] >= T[p1 - 1]);
+        SA[induction_bucket[v1]++] = (p1 - 1) | ((sa_sint_t)(distinct_names[v1] != d) << (SAINT_BIT - 1)); distinct_names[v1] = d;
+    }
+
+    for (j += prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; d += (p < 0); p &= SAINT_MAX; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] >= T[p - 1]);
+        SA[induction_bucket[v]++] = (p - 1) | ((sa_sint_t)(distinct_names[v] != d) << (SAINT_BIT - 1)); distinct_names[v] = d;
+    }
+
+    return d;
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_left_to_right_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t left_suffixes_count, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[4 * k];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * k];
+
+    SA[induction_bucket[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])]++] = (n - 1) | SAINT_MIN;
+    distinct_names[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])] = ++d;
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)left_suffixes_count - 2 * prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetch(&SA[i + 3 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i + 2 * prefetch_distance + 0] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i + 2 * prefetch_distance + 0] & SAINT_MAX] - 2);
+        libsais64_prefetch(&T[SA[i + 2 * prefetch_distance + 1] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i + 2 * prefetch_distance + 1] & SAINT_MAX] - 2);
+
+        sa_sint_t p0 = SA[i + prefetch_distance + 0] & SAINT_MAX; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - (p0 > 0)], 0);
+        libsais64_prefetchw(&induction_bucket[v0]); libsais64_prefetchw(&distinct_names[v0]);
+
+        sa_sint_t p1 = SA[i + prefetch_distance + 1] & SAINT_MAX; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - (p1 > 0)], 0);
+        libsais64_prefetchw(&induction_bucket[v1]); libsais64_prefetchw(&distinct_names[v1]);
+
+        sa_sint_t p2 = SA[i + 0]; d += (p2 < 0); p2 &= SAINT_MAX; sa_sint_t v2 = BUCKETS_INDEX2(T[p2 - 1], T[p2 - 2] >= T[p2 - 1]);
+        SA[induction_bucket[v2]++] = (p2 - 1) | ((sa_sint_t)(distinct_names[v2] != d) << (SAINT_BIT - 1)); distinct_names[v2] = d;
+
+        sa_sint_t p3 = SA[i + 1]; d += (p3 < 0); p3 &= SAINT_MAX; sa_sint_t v3 = BUCKETS_INDEX2(T[p3 - 1], T[p3 - 2] >= T[p3 - 1]);
+        SA[induction_bucket[v3]++] = (p3 - 1) | ((sa_sint_t)(distinct_names[v3] != d) << (SAINT_BIT - 1)); distinct_names[v3] = d;
+    }
+
+    for (j += 2 * prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; d += (p < 0); p &= SAINT_MAX; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] >= T[p - 1]);
+        SA[induction_bucket[v]++] = (p - 1) | ((sa_sint_t)(distinct_names[v] != d) << (SAINT_BIT - 1)); distinct_names[v] = d;
+    }
+
+    return d;
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_left_to_right_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[2 * k];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[0 * k];
+
+    SA[induction_bucket[T[n - 1]]++] = (n - 1) | ((sa_sint_t)(T[n - 2] < T[n - 1]) << (SAINT_BIT - 1)) | SUFFIX_GROUP_MARKER;
+    distinct_names[BUCKETS_INDEX2(T[n - 1], T[n - 2] < T[n - 1])] = ++d;
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - 2 * prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetchw(&SA[i + 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + 2 * prefetch_distance + 0]; const sa_sint_t * Ts0 = &T[s0 & ~SUFFIX_GROUP_MARKER] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i + 2 * prefetch_distance + 1]; const sa_sint_t * Ts1 = &T[s1 & ~SUFFIX_GROUP_MARKER] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i + 1 * prefetch_distance + 0]; if (s2 > 0) { const ptrdiff_t Ts2 = T[(s2 & ~SUFFIX_GROUP_MARKER) - 1]; libsais64_prefetchw(&induction_bucket[Ts2]); libsais64_prefetchw(&distinct_names[BUCKETS_INDEX2(Ts2, 0)]); }
+        sa_sint_t s3 = SA[i + 1 * prefetch_distance + 1]; if (s3 > 0) { const ptrdiff_t Ts3 = T[(s3 & ~SUFFIX_GROUP_MARKER) - 1]; libsais64_prefetchw(&induction_bucket[Ts3]); libsais64_prefetchw(&distinct_names[BUCKETS_INDEX2(Ts3, 0)]); }
+
+        sa_sint_t p0 = SA[i + 0]; SA[i + 0] = p0 & SAINT_MAX;
+        if (p0 > 0)
+        {
+            SA[i + 0] = 0; d += (p0 >> (SUFFIX_GROUP_BIT - 1)); p0 &= ~SUFFIX_GROUP_MARKER; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - 1], T[p0 - 2] < T[p0 - 1]);
+            SA[induction_bucket[T[p0 - 1]]++] = (p0 - 1) | ((sa_sint_t)(T[p0 - 2] < T[p0 - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v0] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v0] = d;
+        }
+
+        sa_sint_t p1 = SA[i + 1]; SA[i + 1] = p1 & SAINT_MAX;
+        if (p1 > 0)
+        {
+            SA[i + 1] = 0; d += (p1 >> (SUFFIX_GROUP_BIT - 1)); p1 &= ~SUFFIX_GROUP_MARKER; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - 1], T[p1 - 2] < T[p1 - 1]);
+            SA[induction_bucket[T[p1 - 1]]++] = (p1 - 1) | ((sa_sint_t)(T[p1 - 2] < T[p1 - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v1] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v1] = d;
+        }
+    }
+
+    for (j += 2 * prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p & SAINT_MAX;
+        if (p > 0)
+        {
+            SA[i] = 0; d += (p >> (SUFFIX_GROUP_BIT - 1)); p &= ~SUFFIX_GROUP_MARKER; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] < T[p - 1]);
+            SA[induction_bucket[T[p - 1]]++] = (p - 1) | ((sa_sint_t)(T[p - 2] < T[p - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v] = d;
+        }
+    }
+
+    return d;
+}
+
+static void libsais64_partial_sorting_scan_left_to_right_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    SA[induction_bucket[T[n - 1]]++] = (n - 1) | ((sa_sint_t)(T[n - 2] < T[n - 1]) << (SAINT_BIT - 1));
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - 2 * prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetchw(&SA[i + 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + 2 * prefetch_distance + 0]; const sa_sint_t * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i + 2 * prefetch_distance + 1]; const sa_sint_t * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i + 1 * prefetch_distance + 0]; if (s2 > 0) { libsais64_prefetchw(&induction_bucket[T[s2 - 1]]); libsais64_prefetch(&T[s2] - 2); }
+        sa_sint_t s3 = SA[i + 1 * prefetch_distance + 1]; if (s3 > 0) { libsais64_prefetchw(&induction_bucket[T[s3 - 1]]); libsais64_prefetch(&T[s3] - 2); }
+
+        sa_sint_t p0 = SA[i + 0]; SA[i + 0] = p0 & SAINT_MAX; if (p0 > 0) { SA[i + 0] = 0; SA[induction_bucket[T[p0 - 1]]++] = (p0 - 1) | ((sa_sint_t)(T[p0 - 2] < T[p0 - 1]) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i + 1]; SA[i + 1] = p1 & SAINT_MAX; if (p1 > 0) { SA[i + 1] = 0; SA[induction_bucket[T[p1 - 1]]++] = (p1 - 1) | ((sa_sint_t)(T[p1 - 2] < T[p1 - 1]) << (SAINT_BIT - 1)); }
+    }
+
+    for (j += 2 * prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p & SAINT_MAX; if (p > 0) { SA[i] = 0; SA[induction_bucket[T[p - 1]]++] = (p - 1) | ((sa_sint_t)(T[p - 2] < T[p - 1]) << (SAINT_BIT - 1)); }
+    }
+}
+
+static void libsais64_partial_sorting_shift_markers_8u(sa_sint_t * RESTRICT SA, const sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    const sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+    
+    ptrdiff_t c;
+    for (c = BUCKETS_INDEX2(UCHAR_MAX, 0); c >= BUCKETS_INDEX2(1, 0); c -= BUCKETS_INDEX2(1, 0))
+    {
+        ptrdiff_t i, j; sa_sint_t s = SAINT_MIN;
+        for (i = (ptrdiff_t)temp_bucket[c] - 1, j = (ptrdiff_t)buckets[c - BUCKETS_INDEX2(1, 0)] + 3; i >= j; i -= 4)
+        {
+            libsais64_prefetchw(&SA[i - prefetch_distance]);
+
+            sa_sint_t p0 = SA[i - 0], q0 = (p0 & SAINT_MIN) ^ s; s = s ^ q0; SA[i - 0] = p0 ^ q0;
+            sa_sint_t p1 = SA[i - 1], q1 = (p1 & SAINT_MIN) ^ s; s = s ^ q1; SA[i - 1] = p1 ^ q1;
+            sa_sint_t p2 = SA[i - 2], q2 = (p2 & SAINT_MIN) ^ s; s = s ^ q2; SA[i - 2] = p2 ^ q2;
+            sa_sint_t p3 = SA[i - 3], q3 = (p3 & SAINT_MIN) ^ s; s = s ^ q3; SA[i - 3] = p3 ^ q3;
+        }
+
+        for (j -= 3; i >= j; i -= 1)
+        {
+            sa_sint_t p = SA[i], q = (p & SAINT_MIN) ^ s; s = s ^ q; SA[i] = p ^ q;
+        }
+    }
+}
+
+static void libsais64_partial_sorting_shift_markers_32s_6k(sa_sint_t * RESTRICT SA, sa_sint_t k, const sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    const sa_sint_t * RESTRICT temp_bucket = &buckets[4 * k];
+    
+    ptrdiff_t c;
+    for (c = BUCKETS_INDEX2((ptrdiff_t)k - 1, 0); c >= BUCKETS_INDEX2(1, 0); c -= BUCKETS_INDEX2(1, 0))
+    {
+        ptrdiff_t i, j; sa_sint_t s = SAINT_MIN;
+        for (i = (ptrdiff_t)temp_bucket[c] - 1, j = (ptrdiff_t)buckets[c - BUCKETS_INDEX2(1, 0)] + 3; i >= j; i -= 4)
+        {
+            libsais64_prefetchw(&SA[i - prefetch_distance]);
+
+            sa_sint_t p0 = SA[i - 0], q0 = (p0 & SAINT_MIN) ^ s; s = s ^ q0; SA[i - 0] = p0 ^ q0;
+            sa_sint_t p1 = SA[i - 1], q1 = (p1 & SAINT_MIN) ^ s; s = s ^ q1; SA[i - 1] = p1 ^ q1;
+            sa_sint_t p2 = SA[i - 2], q2 = (p2 & SAINT_MIN) ^ s; s = s ^ q2; SA[i - 2] = p2 ^ q2;
+            sa_sint_t p3 = SA[i - 3], q3 = (p3 & SAINT_MIN) ^ s; s = s ^ q3; SA[i - 3] = p3 ^ q3;
+        }
+
+        for (j -= 3; i >= j; i -= 1)
+        {
+            sa_sint_t p = SA[i], q = (p & SAINT_MIN) ^ s; s = s ^ q; SA[i] = p ^ q;
+        }
+    }
+}
+
+static void libsais64_partial_sorting_shift_markers_32s_4k(sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i; sa_sint_t s = SUFFIX_GROUP_MARKER;
+    for (i = (ptrdiff_t)n - 1; i >= 3; i -= 4)
+    {
+        libsais64_prefetchw(&SA[i - prefetch_distance]);
+
+        sa_sint_t p0 = SA[i - 0], q0 = ((p0 & SUFFIX_GROUP_MARKER) ^ s) & ((sa_sint_t)(p0 > 0) << ((SUFFIX_GROUP_BIT - 1))); s = s ^ q0; SA[i - 0] = p0 ^ q0;
+        sa_sint_t p1 = SA[i - 1], q1 = ((p1 & SUFFIX_GROUP_MARKER) ^ s) & ((sa_sint_t)(p1 > 0) << ((SUFFIX_GROUP_BIT - 1))); s = s ^ q1; SA[i - 1] = p1 ^ q1;
+        sa_sint_t p2 = SA[i - 2], q2 = ((p2 & SUFFIX_GROUP_MARKER) ^ s) & ((sa_sint_t)(p2 > 0) << ((SUFFIX_GROUP_BIT - 1))); s = s ^ q2; SA[i - 2] = p2 ^ q2;
+        sa_sint_t p3 = SA[i - 3], q3 = ((p3 & SUFFIX_GROUP_MARKER) ^ s) & ((sa_sint_t)(p3 > 0) << ((SUFFIX_GROUP_BIT - 1))); s = s ^ q3; SA[i - 3] = p3 ^ q3;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i], q = ((p & SUFFIX_GROUP_MARKER) ^ s) & ((sa_sint_t)(p > 0) << ((SUFFIX_GROUP_BIT - 1))); s = s ^ q; SA[i] = p ^ q;
+    }
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_right_to_left_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[0 * ALPHABET_SIZE];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
+
+    ptrdiff_t i, j;
+    for (i = (ptrdiff_t)n - (ptrdiff_t)first_lms_suffix - 1, j = (ptrdiff_t)left_suffixes_count + 1 + prefetch_distance + 1; i >= j; i -= 2)
+    {
+        libsais64_prefetch(&SA[i - 2 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 0] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 0] & SAINT_MAX] - 2);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 1] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 1] & SAINT_MAX] - 2);
+
+        sa_sint_t p0 = SA[i - 0]; d += (p0 < 0); p0 &= SAINT_MAX; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - 1], T[p0 - 2] > T[p0 - 1]);
+        SA[--induction_bucket[v0]] = (p0 - 1) | ((sa_sint_t)(distinct_names[v0] != d) << (SAINT_BIT - 1)); distinct_names[v0] = d;
+
+        sa_sint_t p1 = SA[i - 1]; d += (p1 < 0); p1 &= SAINT_MAX; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - 1], T[p1 - 2] > T[p1 - 1]);
+        SA[--induction_bucket[v1]] = (p1 - 1) | ((sa_sint_t)(distinct_names[v1] != d) << (SAINT_BIT - 1)); distinct_names[v1] = d;
+    }
+
+    for (j -= prefetch_distance + 1; i >= j; i -= 1)
+    {
+        sa_sint_t p = SA[i]; d += (p < 0); p &= SAINT_MAX; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] > T[p - 1]);
+        SA[--induction_bucket[v]] = (p - 1) | ((sa_sint_t)(distinct_names[v] != d) << (SAINT_BIT - 1)); distinct_names[v] = d;
+    }
+
+    return d;
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_right_to_left_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[0 * k];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * k];
+
+    ptrdiff_t i, j;
+    for (i = (ptrdiff_t)n - (ptrdiff_t)first_lms_suffix - 1, j = (ptrdiff_t)left_suffixes_count + 1 + 2 * prefetch_distance + 1; i >= j; i -= 2)
+    {
+        libsais64_prefetch(&SA[i - 3 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 0] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 0] & SAINT_MAX] - 2);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 1] & SAINT_MAX] - 1);
+        libsais64_prefetch(&T[SA[i - 2 * prefetch_distance - 1] & SAINT_MAX] - 2);
+
+        sa_sint_t p0 = SA[i - prefetch_distance - 0] & SAINT_MAX; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - (p0 > 0)], 0);
+        libsais64_prefetchw(&induction_bucket[v0]); libsais64_prefetchw(&distinct_names[v0]);
+
+        sa_sint_t p1 = SA[i - prefetch_distance - 1] & SAINT_MAX; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - (p1 > 0)], 0);
+        libsais64_prefetchw(&induction_bucket[v1]); libsais64_prefetchw(&distinct_names[v1]);
+
+        sa_sint_t p2 = SA[i - 0]; d += (p2 < 0); p2 &= SAINT_MAX; sa_sint_t v2 = BUCKETS_INDEX2(T[p2 - 1], T[p2 - 2] > T[p2 - 1]);
+        SA[--induction_bucket[v2]] = (p2 - 1) | ((sa_sint_t)(distinct_names[v2] != d) << (SAINT_BIT - 1)); distinct_names[v2] = d;
+
+        sa_sint_t p3 = SA[i - 1]; d += (p3 < 0); p3 &= SAINT_MAX; sa_sint_t v3 = BUCKETS_INDEX2(T[p3 - 1], T[p3 - 2] > T[p3 - 1]);
+        SA[--induction_bucket[v3]] = (p3 - 1) | ((sa_sint_t)(distinct_names[v3] != d) << (SAINT_BIT - 1)); distinct_names[v3] = d;
+    }
+
+    for (j -= 2 * prefetch_distance + 1; i >= j; i -= 1)
+    {
+        sa_sint_t p = SA[i]; d += (p < 0); p &= SAINT_MAX; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] > T[p - 1]);
+        SA[--induction_bucket[v]] = (p - 1) | ((sa_sint_t)(distinct_names[v] != d) << (SAINT_BIT - 1)); distinct_names[v] = d;
+    }
+
+    return d;
+}
+
+static sa_sint_t libsais64_partial_sorting_scan_right_to_left_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t d)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[3 * k];
+    sa_sint_t * RESTRICT distinct_names   = &buckets[0 * k];
+
+    ptrdiff_t i;
+    for (i = (ptrdiff_t)n - 1; i >= 2 * prefetch_distance + 1; i -= 2)
+    {
+        libsais64_prefetchw(&SA[i - 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i - 2 * prefetch_distance - 0]; const sa_sint_t * Ts0 = &T[s0 & ~SUFFIX_GROUP_MARKER] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i - 2 * prefetch_distance - 1]; const sa_sint_t * Ts1 = &T[s1 & ~SUFFIX_GROUP_MARKER] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i - 1 * prefetch_distance - 0]; if (s2 > 0) { const ptrdiff_t Ts2 = T[(s2 & ~SUFFIX_GROUP_MARKER) - 1]; libsais64_prefetchw(&induction_bucket[Ts2]); libsais64_prefetchw(&distinct_names[BUCKETS_INDEX2(Ts2, 0)]); }
+        sa_sint_t s3 = SA[i - 1 * prefetch_distance - 1]; if (s3 > 0) { const ptrdiff_t Ts3 = T[(s3 & ~SUFFIX_GROUP_MARKER) - 1]; libsais64_prefetchw(&induction_bucket[Ts3]); libsais64_prefetchw(&distinct_names[BUCKETS_INDEX2(Ts3, 0)]); }
+
+        sa_sint_t p0 = SA[i - 0];
+        if (p0 > 0)
+        {
+            SA[i - 0] = 0; d += (p0 >> (SUFFIX_GROUP_BIT - 1)); p0 &= ~SUFFIX_GROUP_MARKER; sa_sint_t v0 = BUCKETS_INDEX2(T[p0 - 1], T[p0 - 2] > T[p0 - 1]);
+            SA[--induction_bucket[T[p0 - 1]]] = (p0 - 1) | ((sa_sint_t)(T[p0 - 2] > T[p0 - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v0] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v0] = d;
+        }
+
+        sa_sint_t p1 = SA[i - 1];
+        if (p1 > 0)
+        {
+            SA[i - 1] = 0; d += (p1 >> (SUFFIX_GROUP_BIT - 1)); p1 &= ~SUFFIX_GROUP_MARKER; sa_sint_t v1 = BUCKETS_INDEX2(T[p1 - 1], T[p1 - 2] > T[p1 - 1]);
+            SA[--induction_bucket[T[p1 - 1]]] = (p1 - 1) | ((sa_sint_t)(T[p1 - 2] > T[p1 - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v1] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v1] = d;
+        }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i];
+        if (p > 0)
+        {
+            SA[i] = 0; d += (p >> (SUFFIX_GROUP_BIT - 1)); p &= ~SUFFIX_GROUP_MARKER; sa_sint_t v = BUCKETS_INDEX2(T[p - 1], T[p - 2] > T[p - 1]);
+            SA[--induction_bucket[T[p - 1]]] = (p - 1) | ((sa_sint_t)(T[p - 2] > T[p - 1]) << (SAINT_BIT - 1)) | ((sa_sint_t)(distinct_names[v] != d) << (SUFFIX_GROUP_BIT - 1)); distinct_names[v] = d;
+        }
+    }
+
+    return d;
+}
+
+static void libsais64_partial_sorting_scan_right_to_left_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i;
+    for (i = (ptrdiff_t)n - 1; i >= 2 * prefetch_distance + 1; i -= 2)
+    {
+        libsais64_prefetchw(&SA[i - 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i - 2 * prefetch_distance - 0]; const sa_sint_t * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i - 2 * prefetch_distance - 1]; const sa_sint_t * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i - 1 * prefetch_distance - 0]; if (s2 > 0) { libsais64_prefetchw(&induction_bucket[T[s2 - 1]]); libsais64_prefetch(&T[s2] - 2); }
+        sa_sint_t s3 = SA[i - 1 * prefetch_distance - 1]; if (s3 > 0) { libsais64_prefetchw(&induction_bucket[T[s3 - 1]]); libsais64_prefetch(&T[s3] - 2); }
+
+        sa_sint_t p0 = SA[i - 0]; if (p0 > 0) { SA[i - 0] = 0; SA[--induction_bucket[T[p0 - 1]]] = (p0 - 1) | ((sa_sint_t)(T[p0 - 2] > T[p0 - 1]) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i - 1]; if (p1 > 0) { SA[i - 1] = 0; SA[--induction_bucket[T[p1 - 1]]] = (p1 - 1) | ((sa_sint_t)(T[p1 - 2] > T[p1 - 1]) << (SAINT_BIT - 1)); }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i]; if (p > 0) { SA[i] = 0; SA[--induction_bucket[T[p - 1]]] = (p - 1) | ((sa_sint_t)(T[p - 2] > T[p - 1]) << (SAINT_BIT - 1)); }
+    }
+}
+
+static void libsais64_partial_sorting_gather_lms_suffixes_32s_4k(sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i, j, l;
+    for (i = 0, j = (ptrdiff_t)n - 3, l = 0; i < j; i += 4)
+    {
+        libsais64_prefetch(&SA[i + prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + 0]; SA[l] = (s0 - SUFFIX_GROUP_MARKER) & (~SUFFIX_GROUP_MARKER); l += (s0 < 0);
+        sa_sint_t s1 = SA[i + 1]; SA[l] = (s1 - SUFFIX_GROUP_MARKER) & (~SUFFIX_GROUP_MARKER); l += (s1 < 0);
+        sa_sint_t s2 = SA[i + 2]; SA[l] = (s2 - SUFFIX_GROUP_MARKER) & (~SUFFIX_GROUP_MARKER); l += (s2 < 0);
+        sa_sint_t s3 = SA[i + 3]; SA[l] = (s3 - SUFFIX_GROUP_MARKER) & (~SUFFIX_GROUP_MARKER); l += (s3 < 0);
+    }
+
+    for (j += 3; i < j; i += 1)
+    {
+        sa_sint_t s = SA[i]; SA[l] = (s - SUFFIX_GROUP_MARKER) & (~SUFFIX_GROUP_MARKER); l += (s < 0);
+    }
+}
+
+static void libsais64_partial_sorting_gather_lms_suffixes_32s_1k(sa_sint_t * RESTRICT SA, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i, j, l;
+    for (i = 0, j = (ptrdiff_t)n - 3, l = 0; i < j; i += 4)
+    {
+        libsais64_prefetch(&SA[i + prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + 0]; SA[l] = s0 & SAINT_MAX; l += (s0 < 0);
+        sa_sint_t s1 = SA[i + 1]; SA[l] = s1 & SAINT_MAX; l += (s1 < 0);
+        sa_sint_t s2 = SA[i + 2]; SA[l] = s2 & SAINT_MAX; l += (s2 < 0);
+        sa_sint_t s3 = SA[i + 3]; SA[l] = s3 & SAINT_MAX; l += (s3 < 0);
+    }
+
+    for (j += 3; i < j; i += 1)
+    {
+        sa_sint_t s = SA[i]; SA[l] = s & SAINT_MAX; l += (s < 0);
+    }
+}
+
+static void libsais64_induce_partial_order_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+{
+    memset(&buckets[2 * ALPHABET_SIZE], 0, 2 * ALPHABET_SIZE * sizeof(sa_sint_t));
+
+    sa_sint_t d = libsais64_partial_sorting_scan_left_to_right_8u(T, SA, n, buckets, left_suffixes_count, 0);
+    libsais64_partial_sorting_shift_markers_8u(SA, buckets);
+    libsais64_partial_sorting_scan_right_to_left_8u(T, SA, n, buckets, first_lms_suffix, left_suffixes_count, d);
+}
+
+static void libsais64_induce_partial_order_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+{
+    memset(&buckets[2 * k], 0, 2 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t d = libsais64_partial_sorting_scan_left_to_right_32s_6k(T, SA, n, k, buckets, left_suffixes_count, 0);
+    libsais64_partial_sorting_shift_markers_32s_6k(SA, k, buckets);
+    libsais64_partial_sorting_scan_right_to_left_32s_6k(T, SA, n, k, buckets, first_lms_suffix, left_suffixes_count, d);
+}
+
+static void libsais64_induce_partial_order_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    memset(buckets, 0, 2 * (size_t)k * sizeof(sa_sint_t));
+
+    sa_sint_t d = libsais64_partial_sorting_scan_left_to_right_32s_4k(T, SA, n, k, buckets, 0);
+    libsais64_partial_sorting_shift_markers_32s_4k(SA, n);
+    libsais64_partial_sorting_scan_right_to_left_32s_4k(T, SA, n, k, buckets, d);
+    libsais64_partial_sorting_gather_lms_suffixes_32s_4k(SA, n);
+}
+
+static void libsais64_induce_partial_order_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_partial_sorting_scan_left_to_right_32s_1k(T, SA, n, k, &buckets[1 * k]);
+    libsais64_partial_sorting_scan_right_to_left_32s_1k(T, SA, n, k, &buckets[0 * k]);
+    libsais64_partial_sorting_gather_lms_suffixes_32s_1k(SA, n);
+}
+
+static void libsais64_induce_partial_order_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_count_suffixes_32s(T, n, k, buckets);
+    libsais64_initialize_buckets_start_32s_1k(k, buckets);
+    libsais64_partial_sorting_scan_left_to_right_32s_1k(T, SA, n, k, buckets);
+
+    libsais64_count_suffixes_32s(T, n, k, buckets);
+    libsais64_initialize_buckets_end_32s_1k(k, buckets);
+    libsais64_partial_sorting_scan_right_to_left_32s_1k(T, SA, n, k, buckets);
+
+    libsais64_partial_sorting_gather_lms_suffixes_32s_1k(SA, n);
+}
+
+static sa_sint_t libsais64_renumber_and_gather_lms_suffixes_8u(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t fs)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT SAm = &SA[m];
+
+    memset(SAm, 0, ((size_t)n >> 1) * sizeof(sa_sint_t));
+
+    ptrdiff_t i, j; sa_sint_t name = 0;
+    for (i = 0, j = (ptrdiff_t)m - prefetch_distance - 3; i < j; i += 4)
+    {
+        libsais64_prefetch(&SA[i + 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 0] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 1] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 2] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 3] & SAINT_MAX) >> 1]);
+
+        sa_sint_t p0 = SA[i + 0]; SAm[(p0 & SAINT_MAX) >> 1] = name | SAINT_MIN; name += p0 < 0;
+        sa_sint_t p1 = SA[i + 1]; SAm[(p1 & SAINT_MAX) >> 1] = name | SAINT_MIN; name += p1 < 0;
+        sa_sint_t p2 = SA[i + 2]; SAm[(p2 & SAINT_MAX) >> 1] = name | SAINT_MIN; name += p2 < 0;
+        sa_sint_t p3 = SA[i + 3]; SAm[(p3 & SAINT_MAX) >> 1] = name | SAINT_MIN; name += p3 < 0;
+    }
+
+    for (j += prefetch_distance + 3; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SAm[(p & SAINT_MAX) >> 1] = name | SAINT_MIN; name += p < 0;
+    }
+
+    if (name < m)
+    {
+        ptrdiff_t l;
+        for (i = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 1, j = (ptrdiff_t)m + 3, l = (ptrdiff_t)n + (ptrdiff_t)fs - 1; i >= j; i -= 4)
+        {
+            libsais64_prefetch(&SA[i - prefetch_distance]);
+
+            sa_sint_t s0 = SA[i - 0]; SA[l] = s0 & SAINT_MAX; l -= s0 < 0;
+            sa_sint_t s1 = SA[i - 1]; SA[l] = s1 & SAINT_MAX; l -= s1 < 0;
+            sa_sint_t s2 = SA[i - 2]; SA[l] = s2 & SAINT_MAX; l -= s2 < 0;
+            sa_sint_t s3 = SA[i - 3]; SA[l] = s3 & SAINT_MAX; l -= s3 < 0;
+        }
+
+        for (j -= 3; i >= j; i -= 1)
+        {
+            sa_sint_t s = SA[i]; SA[l] = s & SAINT_MAX; l -= s < 0;
+        }
+    }
+    else
+    {
+        for (i = 0; i < m; i += 1) { SA[i] &= SAINT_MAX; }
+    }
+
+    return name;
+}
+
+static sa_sint_t libsais64_renumber_and_mark_distinct_lms_suffixes_32s_4k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT SAm = &SA[m];
+
+    memset(SAm, 0, ((size_t)n >> 1) * sizeof(sa_sint_t));
+
+    ptrdiff_t i, j; sa_sint_t p0, p1, p2, p3 = -1, name = 1;
+    for (i = 0, j = (ptrdiff_t)m - prefetch_distance - 3; i < j; i += 4)
+    {
+        libsais64_prefetchw(&SA[i + 2 * prefetch_distance]);
+
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 0] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 1] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 2] & SAINT_MAX) >> 1]);
+        libsais64_prefetchw(&SAm[(SA[i + prefetch_distance + 3] & SAINT_MAX) >> 1]);
+
+        p0 = SA[i + 0]; SAm[(SA[i + 0] = p0 & SAINT_MAX) >> 1] = name | (p0 & p3 & SAINT_MIN); name += p0 < 0;
+        p1 = SA[i + 1]; SAm[(SA[i + 1] = p1 & SAINT_MAX) >> 1] = name | (p1 & p0 & SAINT_MIN); name += p1 < 0;
+        p2 = SA[i + 2]; SAm[(SA[i + 2] = p2 & SAINT_MAX) >> 1] = name | (p2 & p1 & SAINT_MIN); name += p2 < 0;
+        p3 = SA[i + 3]; SAm[(SA[i + 3] = p3 & SAINT_MAX) >> 1] = name | (p3 & p2 & SAINT_MIN); name += p3 < 0;
+    }
+
+    for (j += prefetch_distance + 3; i < j; i += 1)
+    {
+        p2 = p3; p3 = SA[i]; SAm[(SA[i] = p3 & SAINT_MAX) >> 1] = name | (p3 & p2 & SAINT_MIN); name += p3 < 0;
+    }
+    
+    if (name <= m)
+    {
+        p3 = -1;
+        for (i = m, j = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 3; i < j; i += 4)
+        {
+            libsais64_prefetchw(&SA[i + prefetch_distance]);
+
+            p0 = SA[i + 0]; SA[i + 0] = p0 & (p3 | SAINT_MAX); p0 = (p0 == 0) ? p3 : p0;
+            p1 = SA[i + 1]; SA[i + 1] = p1 & (p0 | SAINT_MAX); p1 = (p1 == 0) ? p0 : p1;
+            p2 = SA[i + 2]; SA[i + 2] = p2 & (p1 | SAINT_MAX); p2 = (p2 == 0) ? p1 : p2;
+            p3 = SA[i + 3]; SA[i + 3] = p3 & (p2 | SAINT_MAX); p3 = (p3 == 0) ? p2 : p3;
+        }
+
+        for (j += 3; i < j; i += 1)
+        {
+            p2 = p3; p3 = SA[i]; SA[i] = p3 & (p2 | SAINT_MAX); p3 = (p3 == 0) ? p2 : p3;
+        }
+    }
+
+    return name - 1;
+}
+
+static sa_sint_t libsais64_renumber_and_mark_distinct_lms_suffixes_32s_1k(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT SAm = &SA[m];
+
+    {
+        libsais64_gather_lms_suffixes_32s(T, SA, n);
+
+        memset(&SA[m], 0, ((size_t)n - (size_t)m - (size_t)m) * sizeof(sa_sint_t));
+
+        ptrdiff_t i, j;
+        for (i = (ptrdiff_t)n - (ptrdiff_t)m, j = (ptrdiff_t)n - 1 - prefetch_distance - 3; i < j; i += 4)
+        {
+            libsais64_prefetch(&SA[i + 2 * prefetch_distance]);
+
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 0]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 1]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 2]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 3]) >> 1]);
+
+            SAm[((sa_uint_t)SA[i + 0]) >> 1] = SA[i + 1] - SA[i + 0] + 1 + SAINT_MIN;
+            SAm[((sa_uint_t)SA[i + 1]) >> 1] = SA[i + 2] - SA[i + 1] + 1 + SAINT_MIN;
+            SAm[((sa_uint_t)SA[i + 2]) >> 1] = SA[i + 3] - SA[i + 2] + 1 + SAINT_MIN;
+            SAm[((sa_uint_t)SA[i + 3]) >> 1] = SA[i + 4] - SA[i + 3] + 1 + SAINT_MIN;
+        }
+
+        for (j += prefetch_distance + 3; i < j; i += 1)
+        {
+            SAm[((sa_uint_t)SA[i]) >> 1] = SA[i + 1] - SA[i] + 1 + SAINT_MIN;
+        }
+
+        SAm[((sa_uint_t)SA[n - 1]) >> 1] = 1 + SAINT_MIN;
+    }
+
+    {
+        ptrdiff_t i, j;
+        for (i = 0, j = (ptrdiff_t)(n >> 1) - 3; i < j; i += 4)
+        {
+            libsais64_prefetchw(&SAm[i + prefetch_distance]);
+
+            SAm[i + 0] = (SAm[i + 0] < 0 ? SAm[i + 0] : 0) & SAINT_MAX;
+            SAm[i + 1] = (SAm[i + 1] < 0 ? SAm[i + 1] : 0) & SAINT_MAX;
+            SAm[i + 2] = (SAm[i + 2] < 0 ? SAm[i + 2] : 0) & SAINT_MAX;
+            SAm[i + 3] = (SAm[i + 3] < 0 ? SAm[i + 3] : 0) & SAINT_MAX;
+        }
+
+        for (j += 3; i < j; i += 1)
+        {
+            SAm[i] = (SAm[i] < 0 ? SAm[i] : 0) & SAINT_MAX;
+        }
+    }
+
+    sa_sint_t name = 1;
+
+    {
+        ptrdiff_t i, j, p = SA[0], plen = SAm[p >> 1]; sa_sint_t pdiff = SAINT_MIN;
+        for (i = 1, j = m - prefetch_distance - 1; i < j; i += 2)
+        {
+            libsais64_prefetch(&SA[i + 2 * prefetch_distance]);
+            
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 0]) >> 1]); libsais64_prefetch(&T[((sa_uint_t)SA[i + prefetch_distance + 0])]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + prefetch_distance + 1]) >> 1]); libsais64_prefetch(&T[((sa_uint_t)SA[i + prefetch_distance + 1])]);
+
+            ptrdiff_t q = SA[i + 0], qlen = SAm[q >> 1]; sa_sint_t qdiff = SAINT_MIN;
+            if (plen == qlen) { ptrdiff_t l = 0; do { if (T[p + l] != T[q + l]) { break; } } while (++l < qlen); qdiff = (l - qlen) & SAINT_MIN; }
+            SAm[p >> 1] = name | (pdiff & qdiff); name += (qdiff < 0);
+
+            p = SA[i + 1]; plen = SAm[p >> 1]; pdiff = SAINT_MIN;
+            if (qlen == plen) { ptrdiff_t l = 0; do { if (T[q + l] != T[p + l]) { break; } } while (++l < plen); pdiff = (l - plen) & SAINT_MIN; }
+            SAm[q >> 1] = name | (qdiff & pdiff); name += (pdiff < 0);
+        }
+
+        for (j += prefetch_distance + 1; i < j; i += 1)
+        {
+            ptrdiff_t q = SA[i], qlen = SAm[q >> 1]; sa_sint_t qdiff = SAINT_MIN;
+            if (plen == qlen) { ptrdiff_t l = 0; do { if (T[p + l] != T[q + l]) { break; } } while (++l < plen); qdiff = (l - plen) & SAINT_MIN; }
+            SAm[p >> 1] = name | (pdiff & qdiff); name += (qdiff < 0);
+
+            p = q; plen = qlen; pdiff = qdiff;
+        }
+
+        SAm[p >> 1] = name | pdiff; name++;
+    }
+
+    if (name <= m)
+    {
+        ptrdiff_t i, j; sa_sint_t p0, p1, p2, p3 = -1;
+        for (i = m, j = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 3; i < j; i += 4)
+        {
+            libsais64_prefetchw(&SA[i + prefetch_distance]);
+
+            p0 = SA[i + 0]; SA[i + 0] = p0 & (p3 | SAINT_MAX); p0 = (p0 == 0) ? p3 : p0;
+            p1 = SA[i + 1]; SA[i + 1] = p1 & (p0 | SAINT_MAX); p1 = (p1 == 0) ? p0 : p1;
+            p2 = SA[i + 2]; SA[i + 2] = p2 & (p1 | SAINT_MAX); p2 = (p2 == 0) ? p1 : p2;
+            p3 = SA[i + 3]; SA[i + 3] = p3 & (p2 | SAINT_MAX); p3 = (p3 == 0) ? p2 : p3;
+        }
+
+        for (j += 3; i < j; i += 1)
+        {
+            p2 = p3; p3 = SA[i]; SA[i] = p3 & (p2 | SAINT_MAX); p3 = (p3 == 0) ? p2 : p3;
+        }
+    }
+
+    return name - 1;
+}
+
+static void libsais64_reconstruct_lms_suffixes(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    const sa_sint_t * RESTRICT SAnm = &SA[n - m];
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)m - prefetch_distance - 3; i < j; i += 4)
+    { 
+        libsais64_prefetchw(&SA[i + 2 * prefetch_distance]);
+
+        libsais64_prefetch(&SAnm[SA[i + prefetch_distance + 0]]); 
+        libsais64_prefetch(&SAnm[SA[i + prefetch_distance + 1]]);
+        libsais64_prefetch(&SAnm[SA[i + prefetch_distance + 2]]);
+        libsais64_prefetch(&SAnm[SA[i + prefetch_distance + 3]]);
+
+        SA[i + 0] = SAnm[SA[i + 0]];
+        SA[i + 1] = SAnm[SA[i + 1]];
+        SA[i + 2] = SAnm[SA[i + 2]];
+        SA[i + 3] = SAnm[SA[i + 3]];
+    }
+
+    for (j += prefetch_distance + 3; i < j; i += 1)
+    {
+        SA[i] = SAnm[SA[i]];
+    }
+}
+
+static void libsais64_place_lms_suffixes_interval_8u(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    const sa_sint_t * RESTRICT bucket_end = &buckets[7 * ALPHABET_SIZE];
+
+    ptrdiff_t c, j = n;
+    for (c = UCHAR_MAX - 1; c >= 0; --c)
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[BUCKETS_INDEX2(c, 1) + BUCKETS_INDEX2(1, 0)] - (ptrdiff_t)buckets[BUCKETS_INDEX2(c, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = bucket_end[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_interval_32s_4k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    const sa_sint_t * RESTRICT bucket_end = &buckets[3 * k];
+
+    ptrdiff_t c, j = n;
+    for (c = (ptrdiff_t)k - 2; c >= 0; --c)
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[BUCKETS_INDEX2(c, 1) + BUCKETS_INDEX2(1, 0)] - (ptrdiff_t)buckets[BUCKETS_INDEX2(c, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = bucket_end[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_interval_32s_2k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t c, j = n;
+    for (c = BUCKETS_INDEX2((ptrdiff_t)k - 2, 0); c >= BUCKETS_INDEX2(0, 0); c -= BUCKETS_INDEX2(1, 0))
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[c + BUCKETS_INDEX2(1, 1)] - (ptrdiff_t)buckets[c + BUCKETS_INDEX2(0, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = buckets[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_interval_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t c = k - 1; ptrdiff_t i, l = buckets[c];
+    for (i = (ptrdiff_t)m - 1; i >= prefetch_distance + 3; i -= 4)
+    {
+        libsais64_prefetch(&SA[i - 2 * prefetch_distance]);
+
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 0]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 1]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 2]]);
+        libsais64_prefetch(&T[SA[i - prefetch_distance - 3]]);
+
+        sa_sint_t p0 = SA[i - 0]; if (T[p0] != c) { c = T[p0]; memset(&SA[buckets[c]], 0, (size_t)(l - buckets[c]) * sizeof(sa_sint_t)); l = buckets[c]; } SA[--l] = p0;
+        sa_sint_t p1 = SA[i - 1]; if (T[p1] != c) { c = T[p1]; memset(&SA[buckets[c]], 0, (size_t)(l - buckets[c]) * sizeof(sa_sint_t)); l = buckets[c]; } SA[--l] = p1;
+        sa_sint_t p2 = SA[i - 2]; if (T[p2] != c) { c = T[p2]; memset(&SA[buckets[c]], 0, (size_t)(l - buckets[c]) * sizeof(sa_sint_t)); l = buckets[c]; } SA[--l] = p2;
+        sa_sint_t p3 = SA[i - 3]; if (T[p3] != c) { c = T[p3]; memset(&SA[buckets[c]], 0, (size_t)(l - buckets[c]) * sizeof(sa_sint_t)); l = buckets[c]; } SA[--l] = p3;
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i]; if (T[p] != c) { c = T[p]; memset(&SA[buckets[c]], 0, (size_t)(l - buckets[c]) * sizeof(sa_sint_t)); l = buckets[c]; } SA[--l] = p;
+    }
+
+    memset(&SA[0], 0, (size_t)l * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_histogram_32s_6k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    const sa_sint_t * RESTRICT bucket_end = &buckets[5 * k];
+
+    ptrdiff_t c, j = n;
+    for (c = (ptrdiff_t)k - 2; c >= 0; --c)
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[BUCKETS_INDEX4(c, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = bucket_end[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_histogram_32s_4k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    const sa_sint_t * RESTRICT bucket_end = &buckets[3 * k];
+
+    ptrdiff_t c, j = n;
+    for (c = (ptrdiff_t)k - 2; c >= 0; --c)
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[BUCKETS_INDEX2(c, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = bucket_end[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_place_lms_suffixes_histogram_32s_2k(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+{
+    ptrdiff_t c, j = n;
+    for (c = BUCKETS_INDEX2((ptrdiff_t)k - 2, 0); c >= BUCKETS_INDEX2(0, 0); c -= BUCKETS_INDEX2(1, 0))
+    {
+        ptrdiff_t l = (ptrdiff_t)buckets[c + BUCKETS_INDEX2(0, 1)];
+        if (l > 0)
+        {
+            ptrdiff_t i = buckets[c];
+            if (j - i > 0)
+            {
+                memset(&SA[i], 0, (size_t)(j - i) * sizeof(sa_sint_t));
+            }
+
+            memmove(&SA[j = (i - l)], &SA[m -= (sa_sint_t)l], (size_t)l * sizeof(sa_sint_t));
+        }
+    }
+
+    memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
+}
+
+static void libsais64_final_bwt_scan_left_to_right_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[6 * ALPHABET_SIZE];
+
+    SA[induction_bucket[T[n - 1]]++] = (n - 1) | ((sa_sint_t)(T[n - 2] < T[n - 1]) << (SAINT_BIT - 1));
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetchw(&SA[i + 2 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + prefetch_distance + 0]; const unsigned char * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i + prefetch_distance + 1]; const unsigned char * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+
+        sa_sint_t p0 = SA[i + 0]; SA[i + 0] = p0 & SAINT_MAX; if (p0 > 0) { p0--; SA[i + 0] = T[p0] | SAINT_MIN; SA[induction_bucket[T[p0]]++] = p0 | ((sa_sint_t)((T[p0 - (p0 > 0)] < T[p0])) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i + 1]; SA[i + 1] = p1 & SAINT_MAX; if (p1 > 0) { p1--; SA[i + 1] = T[p1] | SAINT_MIN; SA[induction_bucket[T[p1]]++] = p1 | ((sa_sint_t)((T[p1 - (p1 > 0)] < T[p1])) << (SAINT_BIT - 1)); }
+    }
+
+    for (j += prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p & SAINT_MAX; if (p > 0) { p--; SA[i] = T[p] | SAINT_MIN; SA[induction_bucket[T[p]]++] = p | ((sa_sint_t)((T[p - (p > 0)] < T[p])) << (SAINT_BIT - 1)); }
+    }
+}
+
+static void libsais64_final_sorting_scan_left_to_right_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[6 * ALPHABET_SIZE];
+
+    SA[induction_bucket[T[n - 1]]++] = (n - 1) | ((sa_sint_t)(T[n - 2] < T[n - 1]) << (SAINT_BIT - 1));
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetchw(&SA[i + 2 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + prefetch_distance + 0]; const unsigned char * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i + prefetch_distance + 1]; const unsigned char * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+
+        sa_sint_t p0 = SA[i + 0]; SA[i + 0] = p0 ^ SAINT_MIN; if (p0 > 0) { p0--; SA[induction_bucket[T[p0]]++] = p0 | ((sa_sint_t)((T[p0 - (p0 > 0)] < T[p0])) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i + 1]; SA[i + 1] = p1 ^ SAINT_MIN; if (p1 > 0) { p1--; SA[induction_bucket[T[p1]]++] = p1 | ((sa_sint_t)((T[p1 - (p1 > 0)] < T[p1])) << (SAINT_BIT - 1)); }
+    }
+
+    for (j += prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p ^ SAINT_MIN; if (p > 0) { p--; SA[induction_bucket[T[p]]++] = p | ((sa_sint_t)((T[p - (p > 0)] < T[p])) << (SAINT_BIT - 1)); }
+    }
+}
+
+static void libsais64_final_sorting_scan_left_to_right_32s(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT induction_bucket)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    SA[induction_bucket[T[n - 1]]++] = (n - 1) | ((sa_sint_t)(T[n - 2] < T[n - 1]) << (SAINT_BIT - 1));
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - 2 * prefetch_distance - 1; i < j; i += 2)
+    {
+        libsais64_prefetchw(&SA[i + 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i + 2 * prefetch_distance + 0]; const sa_sint_t * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i + 2 * prefetch_distance + 1]; const sa_sint_t * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i + 1 * prefetch_distance + 0]; if (s2 > 0) { libsais64_prefetchw(&induction_bucket[T[s2 - 1]]); libsais64_prefetch(&T[s2] - 2); }
+        sa_sint_t s3 = SA[i + 1 * prefetch_distance + 1]; if (s3 > 0) { libsais64_prefetchw(&induction_bucket[T[s3 - 1]]); libsais64_prefetch(&T[s3] - 2); }
+
+        sa_sint_t p0 = SA[i + 0]; SA[i + 0] = p0 ^ SAINT_MIN; if (p0 > 0) { p0--; SA[induction_bucket[T[p0]]++] = p0 | ((sa_sint_t)((T[p0 - (p0 > 0)] < T[p0])) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i + 1]; SA[i + 1] = p1 ^ SAINT_MIN; if (p1 > 0) { p1--; SA[induction_bucket[T[p1]]++] = p1 | ((sa_sint_t)((T[p1 - (p1 > 0)] < T[p1])) << (SAINT_BIT - 1)); }
+    }
+
+    for (j += 2 * prefetch_distance + 1; i < j; i += 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p ^ SAINT_MIN; if (p > 0) { p--; SA[induction_bucket[T[p]]++] = p | ((sa_sint_t)((T[p - (p > 0)] < T[p])) << (SAINT_BIT - 1)); }
+    }
+}
+
+static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[7 * ALPHABET_SIZE];
+
+    ptrdiff_t i; sa_sint_t index = -1;
+    for (i = (ptrdiff_t)n - 1; i >= prefetch_distance + 1; i -= 2)
+    {
+        libsais64_prefetchw(&SA[i - 2 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i - prefetch_distance - 0]; const unsigned char * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i - prefetch_distance - 1]; const unsigned char * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+
+        sa_sint_t p0 = SA[i - 0]; index = (p0 == 0) ? (sa_sint_t)(i - 0) : index;
+        SA[i - 0] = p0 & SAINT_MAX; if (p0 > 0) { p0--; unsigned char c0 = T[p0 - (p0 > 0)], c1 = T[p0]; SA[i - 0] = c1; sa_sint_t t = c0 | SAINT_MIN; SA[--induction_bucket[c1]] = (c0 <= c1) ? p0 : t; }
+
+        sa_sint_t p1 = SA[i - 1]; index = (p1 == 0) ? (sa_sint_t)(i - 1) : index;
+        SA[i - 1] = p1 & SAINT_MAX; if (p1 > 0) { p1--; unsigned char c0 = T[p1 - (p1 > 0)], c1 = T[p1]; SA[i - 1] = c1; sa_sint_t t = c0 | SAINT_MIN; SA[--induction_bucket[c1]] = (c0 <= c1) ? p1 : t; }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i]; index = (p == 0) ? (sa_sint_t)i : index;
+        SA[i] = p & SAINT_MAX; if (p > 0) { p--; unsigned char c0 = T[p - (p > 0)], c1 = T[p]; SA[i] = c1; sa_sint_t t = c0 | SAINT_MIN; SA[--induction_bucket[c1]] = (c0 <= c1) ? p : t; }
+    }
+
+    return index;
+}
+
+static void libsais64_final_sorting_scan_right_to_left_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t * RESTRICT induction_bucket = &buckets[7 * ALPHABET_SIZE];
+
+    ptrdiff_t i;
+    for (i = (ptrdiff_t)n - 1; i >= prefetch_distance + 1; i -= 2)
+    {
+        libsais64_prefetchw(&SA[i - 2 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i - prefetch_distance - 0]; const unsigned char * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL); Ts0--; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i - prefetch_distance - 1]; const unsigned char * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL); Ts1--; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+
+        sa_sint_t p0 = SA[i - 0]; SA[i - 0] = p0 & SAINT_MAX; if (p0 > 0) { p0--; SA[--induction_bucket[T[p0]]] = p0 | ((sa_sint_t)((T[p0 - (p0 > 0)] > T[p0])) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i - 1]; SA[i - 1] = p1 & SAINT_MAX; if (p1 > 0) { p1--; SA[--induction_bucket[T[p1]]] = p1 | ((sa_sint_t)((T[p1 - (p1 > 0)] > T[p1])) << (SAINT_BIT - 1)); }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p & SAINT_MAX; if (p > 0) { p--; SA[--induction_bucket[T[p]]] = p | ((sa_sint_t)((T[p - (p > 0)] > T[p])) << (SAINT_BIT - 1)); }
+    }
+}
+
+static void libsais64_final_sorting_scan_right_to_left_32s(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT induction_bucket)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i;
+    for (i = (ptrdiff_t)n - 1; i >= 2 * prefetch_distance + 1; i -= 2)
+    {
+        libsais64_prefetchw(&SA[i - 3 * prefetch_distance]);
+
+        sa_sint_t s0 = SA[i - 2 * prefetch_distance - 0]; const sa_sint_t * Ts0 = &T[s0] - 1; libsais64_prefetch(s0 > 0 ? Ts0 : NULL);
+        sa_sint_t s1 = SA[i - 2 * prefetch_distance - 1]; const sa_sint_t * Ts1 = &T[s1] - 1; libsais64_prefetch(s1 > 0 ? Ts1 : NULL);
+        sa_sint_t s2 = SA[i - 1 * prefetch_distance - 0]; if (s2 > 0) { libsais64_prefetchw(&induction_bucket[T[s2 - 1]]); libsais64_prefetch(&T[s2] - 2); }
+        sa_sint_t s3 = SA[i - 1 * prefetch_distance - 1]; if (s3 > 0) { libsais64_prefetchw(&induction_bucket[T[s3 - 1]]); libsais64_prefetch(&T[s3] - 2); }
+
+        sa_sint_t p0 = SA[i - 0]; SA[i - 0] = p0 & SAINT_MAX; if (p0 > 0) { p0--; SA[--induction_bucket[T[p0]]] = p0 | ((sa_sint_t)((T[p0 - (p0 > 0)] > T[p0])) << (SAINT_BIT - 1)); }
+        sa_sint_t p1 = SA[i - 1]; SA[i - 1] = p1 & SAINT_MAX; if (p1 > 0) { p1--; SA[--induction_bucket[T[p1]]] = p1 | ((sa_sint_t)((T[p1 - (p1 > 0)] > T[p1])) << (SAINT_BIT - 1)); }
+    }
+
+    for (; i >= 0; i -= 1)
+    {
+        sa_sint_t p = SA[i]; SA[i] = p & SAINT_MAX; if (p > 0) { p--; SA[--induction_bucket[T[p]]] = p | ((sa_sint_t)((T[p - (p > 0)] > T[p])) << (SAINT_BIT - 1)); }
+    }
+}
+
+static sa_sint_t libsais64_induce_final_order_8u(const unsigned char * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t bwt, sa_sint_t * RESTRICT buckets)
+{
+    if (bwt)
+    {
+        libsais64_final_bwt_scan_left_to_right_8u(T, SA, n, buckets);
+        return libsais64_final_bwt_scan_right_to_left_8u(T, SA, n, buckets);
+    }
+    else
+    {
+        libsais64_final_sorting_scan_left_to_right_8u(T, SA, n, buckets);
+        libsais64_final_sorting_scan_right_to_left_8u(T, SA, n, buckets);
+        return 0;
+    }
+}
+
+static void libsais64_induce_final_order_32s_6k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_final_sorting_scan_left_to_right_32s(T, SA, n, &buckets[4 * k]);
+    libsais64_final_sorting_scan_right_to_left_32s(T, SA, n, &buckets[5 * k]);
+}
+
+static void libsais64_induce_final_order_32s_4k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_final_sorting_scan_left_to_right_32s(T, SA, n, &buckets[2 * k]);
+    libsais64_final_sorting_scan_right_to_left_32s(T, SA, n, &buckets[3 * k]);
+}
+
+static void libsais64_induce_final_order_32s_2k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_final_sorting_scan_left_to_right_32s(T, SA, n, &buckets[1 * k]);
+    libsais64_final_sorting_scan_right_to_left_32s(T, SA, n, &buckets[0 * k]);
+}
+
+static void libsais64_induce_final_order_32s_1k(const sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets)
+{
+    libsais64_count_suffixes_32s(T, n, k, buckets);
+    libsais64_initialize_buckets_start_32s_1k(k, buckets);
+    libsais64_final_sorting_scan_left_to_right_32s(T, SA, n, buckets);
+
+    libsais64_count_suffixes_32s(T, n, k, buckets);
+    libsais64_initialize_buckets_end_32s_1k(k, buckets);
+    libsais64_final_sorting_scan_right_to_left_32s(T, SA, n, buckets);
+}
+
+static sa_sint_t libsais64_compact_lms_suffixes_32s(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t fs)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    sa_sint_t f = 0;
+
+    {
+        sa_sint_t * RESTRICT SAm = &SA[m];
+
+        sa_sint_t i, j;
+        for (i = 0, j = m - 2 * (sa_sint_t)prefetch_distance - 3; i < j; i += 4)
+        {
+            libsais64_prefetch(&SA[i + 3 * prefetch_distance]);
+
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + 2 * prefetch_distance + 0]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + 2 * prefetch_distance + 1]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + 2 * prefetch_distance + 2]) >> 1]);
+            libsais64_prefetchw(&SAm[((sa_uint_t)SA[i + 2 * prefetch_distance + 3]) >> 1]);
+
+            sa_uint_t q0 = (sa_uint_t)SA[i + prefetch_distance + 0]; const sa_sint_t * Tq0 = &T[q0]; libsais64_prefetchw(SAm[q0 >> 1] < 0 ? Tq0 : NULL);
+            sa_uint_t q1 = (sa_uint_t)SA[i + prefetch_distance + 1]; const sa_sint_t * Tq1 = &T[q1]; libsais64_prefetchw(SAm[q1 >> 1] < 0 ? Tq1 : NULL);
+            sa_uint_t q2 = (sa_uint_t)SA[i + prefetch_distance + 2]; const sa_sint_t * Tq2 = &T[q2]; libsais64_prefetchw(SAm[q2 >> 1] < 0 ? Tq2 : NULL);
+            sa_uint_t q3 = (sa_uint_t)SA[i + prefetch_distance + 3]; const sa_sint_t * Tq3 = &T[q3]; libsais64_prefetchw(SAm[q3 >> 1] < 0 ? Tq3 : NULL);
+
+            sa_uint_t p0 = (sa_uint_t)SA[i + 0]; sa_sint_t s0 = SAm[p0 >> 1]; if (s0 < 0) { T[p0] |= SAINT_MIN; f++; s0 = i + 0 + SAINT_MIN + f; } SAm[p0 >> 1] = s0 - f;
+            sa_uint_t p1 = (sa_uint_t)SA[i + 1]; sa_sint_t s1 = SAm[p1 >> 1]; if (s1 < 0) { T[p1] |= SAINT_MIN; f++; s1 = i + 1 + SAINT_MIN + f; } SAm[p1 >> 1] = s1 - f;
+            sa_uint_t p2 = (sa_uint_t)SA[i + 2]; sa_sint_t s2 = SAm[p2 >> 1]; if (s2 < 0) { T[p2] |= SAINT_MIN; f++; s2 = i + 2 + SAINT_MIN + f; } SAm[p2 >> 1] = s2 - f;
+            sa_uint_t p3 = (sa_uint_t)SA[i + 3]; sa_sint_t s3 = SAm[p3 >> 1]; if (s3 < 0) { T[p3] |= SAINT_MIN; f++; s3 = i + 3 + SAINT_MIN + f; } SAm[p3 >> 1] = s3 - f;
+        }
+
+        for (j += 2 * (sa_sint_t)prefetch_distance + 3; i < j; i += 1)
+        {
+            sa_uint_t p = (sa_uint_t)SA[i]; sa_sint_t s = SAm[p >> 1]; if (s < 0) { T[p] |= SAINT_MIN; f++; s = i + SAINT_MIN + f; } SAm[p >> 1] = s - f;
+        }
+    }
+
+    {
+        sa_sint_t * RESTRICT SAl = &SA[0];
+        sa_sint_t * RESTRICT SAr = &SA[0];
+
+        ptrdiff_t i, j, l = (ptrdiff_t)m - 1, r = (ptrdiff_t)n + (ptrdiff_t)fs - 1;
+        for (i = (ptrdiff_t)m + ((ptrdiff_t)n >> 1) - 1, j = (ptrdiff_t)m + 3; i >= j; i -= 4)
+        {
+            libsais64_prefetch(&SA[i - prefetch_distance]);
+
+            sa_sint_t p0 = SA[i - 0]; SAl[l] = p0 & SAINT_MAX; l -= p0 < 0; SAr[r] = p0 - 1; r -= p0 > 0;
+            sa_sint_t p1 = SA[i - 1]; SAl[l] = p1 & SAINT_MAX; l -= p1 < 0; SAr[r] = p1 - 1; r -= p1 > 0;
+            sa_sint_t p2 = SA[i - 2]; SAl[l] = p2 & SAINT_MAX; l -= p2 < 0; SAr[r] = p2 - 1; r -= p2 > 0;
+            sa_sint_t p3 = SA[i - 3]; SAl[l] = p3 & SAINT_MAX; l -= p3 < 0; SAr[r] = p3 - 1; r -= p3 > 0;
+        }
+
+        for (j -= 3; i >= j; i -= 1)
+        {
+            sa_sint_t p = SA[i]; SAl[l] = p & SAINT_MAX; l -= p < 0; SAr[r] = p - 1; r -= p > 0;
+        }
+
+        memcpy(&SA[(ptrdiff_t)n + (ptrdiff_t)fs - (ptrdiff_t)m], &SA[(ptrdiff_t)l + 1], (size_t)f * sizeof(sa_sint_t));
+    }
+
+    return f;
+}
+
+static void libsais64_merge_compacted_lms_suffixes_32s(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t f)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    const sa_sint_t * RESTRICT SAnm = &SA[n - m - 1];
+
+    {
+        sa_sint_t i, j, l = 0, tmp = SAnm[l];
+        for (i = 0, j = n - 6; i < j; i += 4)
+        {
+            libsais64_prefetch(&T[i + prefetch_distance]);
+
+            sa_sint_t c0 = T[i + 0]; if (c0 < 0) { T[i + 0] = c0 & SAINT_MAX; SA[tmp] = i + 0; i++; tmp = SAnm[++l]; }
+            sa_sint_t c1 = T[i + 1]; if (c1 < 0) { T[i + 1] = c1 & SAINT_MAX; SA[tmp] = i + 1; i++; tmp = SAnm[++l]; }
+            sa_sint_t c2 = T[i + 2]; if (c2 < 0) { T[i + 2] = c2 & SAINT_MAX; SA[tmp] = i + 2; i++; tmp = SAnm[++l]; }
+            sa_sint_t c3 = T[i + 3]; if (c3 < 0) { T[i + 3] = c3 & SAINT_MAX; SA[tmp] = i + 3; i++; tmp = SAnm[++l]; }
+        }
+
+        for (j += 6; i < j; i += 1)
+        {
+            sa_sint_t c0 = T[i]; if (c0 < 0) { T[i] = c0 & SAINT_MAX; SA[tmp] = i; i++; tmp = SAnm[++l]; }
+        }
+    }
+
+    {
+        ptrdiff_t i, j, l = f; sa_sint_t tmp = SAnm[l];
+        for (i = 0, j = (ptrdiff_t)m - 3; i < j; i += 4)
+        {
+            libsais64_prefetch(&SA[i + prefetch_distance]);
+
+            if (SA[i + 0] == 0) { SA[i + 0] = tmp; tmp = SAnm[++l]; }
+            if (SA[i + 1] == 0) { SA[i + 1] = tmp; tmp = SAnm[++l]; }
+            if (SA[i + 2] == 0) { SA[i + 2] = tmp; tmp = SAnm[++l]; }
+            if (SA[i + 3] == 0) { SA[i + 3] = tmp; tmp = SAnm[++l]; }
+        }
+
+        for (j += 3; i < j; i += 1)
+        {
+            if (SA[i] == 0) { SA[i] = tmp; tmp = SAnm[++l]; }
+        }
+    }
+}
+
+static void libsais64_reconstruct_compacted_lms_suffixes_32s_2k(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, sa_sint_t fs, sa_sint_t f, sa_sint_t * RESTRICT buckets)
+{
+    if (f > 0)
+    {
+        memcpy(&SA[n - m - 1], &SA[n + fs - m], (size_t)f * sizeof(sa_sint_t));
+
+        libsais64_count_and_gather_compacted_lms_suffixes_32s_2k(T, SA, n, k, buckets);
+        libsais64_reconstruct_lms_suffixes(SA, n, m - f);
+
+        memcpy(&SA[n - m - 1 + f], &SA[0], ((size_t)m - (size_t)f) * sizeof(sa_sint_t));
+        memset(&SA[0], 0, (size_t)m * sizeof(sa_sint_t));
+
+        libsais64_merge_compacted_lms_suffixes_32s(T, SA, n, m, f);
+    }
+    else
+    {
+        libsais64_count_and_gather_lms_suffixes_32s_2k(T, SA, n, k, buckets);
+        libsais64_reconstruct_lms_suffixes(SA, n, m);
+    }
+}
+
+static void libsais64_reconstruct_compacted_lms_suffixes_32s_1k(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t m, sa_sint_t fs, sa_sint_t f)
+{
+    if (f > 0)
+    {
+        memmove(&SA[n - m - 1], &SA[n + fs - m], (size_t)f * sizeof(sa_sint_t));
+
+        libsais64_gather_compacted_lms_suffixes_32s(T, SA, n);
+        libsais64_reconstruct_lms_suffixes(SA, n, m - f);
+
+        memcpy(&SA[n - m - 1 + f], &SA[0], ((size_t)m - (size_t)f) * sizeof(sa_sint_t));
+        memset(&SA[0], 0, (size_t)m * sizeof(sa_sint_t));
+
+        libsais64_merge_compacted_lms_suffixes_32s(T, SA, n, m, f);
+    }
+    else
+    {
+        libsais64_gather_lms_suffixes_32s(T, SA, n);
+        libsais64_reconstruct_lms_suffixes(SA, n, m);
+    }
+}
+
+static sa_sint_t libsais64_main_32s(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs, LIBSAIS64_CONTEXT * RESTRICT ctx)
+{
+    if (k > 0 && fs / k >= 6)
+    {
+        sa_sint_t alignment = (fs - 1024) / k >= 6 ? 1024 : 16;
+        sa_sint_t * RESTRICT buckets = (fs - alignment) / k >= 6 ? (sa_sint_t *)libsais64_align_up(&SA[n + fs - 6 * k - alignment], (size_t)alignment * sizeof(sa_sint_t)) : &SA[n + fs - 6 * k];
+
+        sa_sint_t m = libsais64_count_and_gather_lms_suffixes_32s_4k(T, SA, n, k, buckets);
+        if (m > 1)
+        {
+            memset(SA, 0, ((size_t)n - (size_t)m) * sizeof(sa_sint_t));
+
+            sa_sint_t first_lms_suffix    = SA[n - m];
+            sa_sint_t left_suffixes_count = libsais64_initialize_buckets_for_lms_suffixes_radix_sort_32s_6k(T, k, buckets, first_lms_suffix);
+
+            libsais64_radix_sort_lms_suffixes_32s_2k(T, SA, n, m, &buckets[4 * k]);
+            libsais64_radix_sort_set_markers_32s(SA, k, &buckets[4 * k], SAINT_MIN);
+
+            libsais64_initialize_buckets_for_partial_sorting_32s_6k(T, k, buckets, first_lms_suffix, left_suffixes_count);
+            libsais64_induce_partial_order_32s_6k(T, SA, n, k, buckets, first_lms_suffix, left_suffixes_count);
+
+            sa_sint_t names = libsais64_renumber_and_mark_distinct_lms_suffixes_32s_4k(SA, n, m);
+            if (names < m)
+            {
+                sa_sint_t f = libsais64_compact_lms_suffixes_32s(T, SA, n, m, fs);
+
+                if (libsais64_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
+                {
+                    return -2;
+                }
+
+                libsais64_reconstruct_compacted_lms_suffixes_32s_2k(T, SA, n, k, m, fs, f, buckets);
+            }
+            else
+            {
+                libsais64_count_lms_suffixes_32s_2k(T, n, k, buckets);
+            }
+
+            libsais64_initialize_buckets_start_and_end_32s_4k(k, buckets);
+            libsais64_place_lms_suffixes_histogram_32s_4k(SA, n, k, m, buckets);
+            libsais64_induce_final_order_32s_4k(T, SA, n, k, buckets);
+        }
+        else
+        {
+            SA[0] = SA[n - 1];
+
+            libsais64_initialize_buckets_start_and_end_32s_6k(k, buckets);
+            libsais64_place_lms_suffixes_histogram_32s_6k(SA, n, k, m, buckets);
+            libsais64_induce_final_order_32s_6k(T, SA, n, k, buckets);
+        }
+
+        return 0;
+    }
+    else if (k > 0 && fs / k >= 4)
+    {
+        sa_sint_t alignment = (fs - 1024) / k >= 4 ? 1024 : 16;
+        sa_sint_t * RESTRICT buckets = (fs - alignment) / k >= 4 ? (sa_sint_t *)libsais64_align_up(&SA[n + fs - 4 * k - alignment], (size_t)alignment * sizeof(sa_sint_t)) : &SA[n + fs - 4 * k];
+
+        sa_sint_t m = libsais64_count_and_gather_lms_suffixes_32s_2k(T, SA, n, k, buckets);
+        if (m > 1)
+        {
+            libsais64_initialize_buckets_for_radix_and_partial_sorting_32s_4k(T, k, buckets, SA[n - m]);
+
+            libsais64_radix_sort_lms_suffixes_32s_2k(T, SA, n, m, &buckets[1]);
+            libsais64_radix_sort_set_markers_32s(SA, k, &buckets[1], SUFFIX_GROUP_MARKER);
+            
+            libsais64_place_lms_suffixes_interval_32s_4k(SA, n, k, m - 1, buckets);
+            libsais64_induce_partial_order_32s_4k(T, SA, n, k, buckets);
+
+            sa_sint_t names = libsais64_renumber_and_mark_distinct_lms_suffixes_32s_4k(SA, n, m);
+            if (names < m)
+            {
+                sa_sint_t f = libsais64_compact_lms_suffixes_32s(T, SA, n, m, fs);
+
+                if (libsais64_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
+                {
+                    return -2;
+                }
+
+                libsais64_reconstruct_compacted_lms_suffixes_32s_2k(T, SA, n, k, m, fs, f, buckets);
+            }
+            else
+            {
+                libsais64_count_lms_suffixes_32s_2k(T, n, k, buckets);
+            }
+        }
+        else
+        {
+            SA[0] = SA[n - 1];
+        }
+
+        libsais64_initialize_buckets_start_and_end_32s_4k(k, buckets);
+        libsais64_place_lms_suffixes_histogram_32s_4k(SA, n, k, m, buckets);
+        libsais64_induce_final_order_32s_4k(T, SA, n, k, buckets);
+
+        return 0;
+    }
+    else if (k > 0 && fs / k >= 2)
+    {
+        sa_sint_t alignment = (fs - 1024) / k >= 2 ? 1024 : 16;
+        sa_sint_t * RESTRICT buckets = (fs - alignment) / k >= 2 ? (sa_sint_t *)libsais64_align_up(&SA[n + fs - 2 * k - alignment], (size_t)alignment * sizeof(sa_sint_t)) : &SA[n + fs - 2 * k];
+
+        sa_sint_t m = libsais64_count_and_gather_lms_suffixes_32s_2k(T, SA, n, k, buckets);
+        if (m > 1)
+        {
+            libsais64_initialize_buckets_for_lms_suffixes_radix_sort_32s_2k(T, k, buckets, SA[n - m]);
+
+            libsais64_radix_sort_lms_suffixes_32s_2k(T, SA, n, m, &buckets[1]);
+            libsais64_place_lms_suffixes_interval_32s_2k(SA, n, k, m - 1, buckets);
+
+            libsais64_initialize_buckets_start_and_end_32s_2k(k, buckets);
+            libsais64_induce_partial_order_32s_2k(T, SA, n, k, buckets);
+
+            sa_sint_t names = libsais64_renumber_and_mark_distinct_lms_suffixes_32s_1k(T, SA, n, m);
+            if (names < m)
+            {
+                sa_sint_t f = libsais64_compact_lms_suffixes_32s(T, SA, n, m, fs);
+
+                if (libsais64_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
+                {
+                    return -2;
+                }
+
+                libsais64_reconstruct_compacted_lms_suffixes_32s_2k(T, SA, n, k, m, fs, f, buckets);
+            }
+            else
+            {
+                libsais64_count_lms_suffixes_32s_2k(T, n, k, buckets);
+            }
+        }
+        else
+        {
+            SA[0] = SA[n - 1];
+        }
+
+        libsais64_initialize_buckets_end_32s_2k(k, buckets);
+        libsais64_place_lms_suffixes_histogram_32s_2k(SA, n, k, m, buckets);
+
+        libsais64_initialize_buckets_start_and_end_32s_2k(k, buckets);
+        libsais64_induce_final_order_32s_2k(T, SA, n, k, buckets);
+
+        return 0;
+    }
+    else
+    {
+        sa_sint_t * buffer = fs < k ? libsais64_ctx_buffer(ctx, k) : (sa_sint_t *)NULL;
+
+        sa_sint_t alignment = fs - 1024 >= k ? 1024 : 16;
+        sa_sint_t * RESTRICT buckets = fs - alignment >= k ? (sa_sint_t *)libsais64_align_up(&SA[n + fs - k - alignment], (size_t)alignment * sizeof(sa_sint_t)) : fs >= k ? &SA[n + fs - k] : buffer;
+
+        if (buckets == NULL) { return -2; }
+
+        memset(SA, 0, (size_t)n * sizeof(sa_sint_t));
+
+        libsais64_count_suffixes_32s(T, n, k, buckets); 
+        libsais64_initialize_buckets_end_32s_1k(k, buckets);
+
+        sa_sint_t m = libsais64_radix_sort_lms_suffixes_32s_1k(T, SA, n, buckets);
+        if (m > 1)
+        {
+            libsais64_induce_partial_order_32s_1k(T, SA, n, k, buckets);
+
+            sa_sint_t names = libsais64_renumber_and_mark_distinct_lms_suffixes_32s_1k(T, SA, n, m);
+            if (names < m)
+            {
+                if (buffer != NULL) { buckets = NULL; }
+
+                sa_sint_t f = libsais64_compact_lms_suffixes_32s(T, SA, n, m, fs);
+
+                if (libsais64_main_32s(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, ctx) != 0)
+                {
+                    return -2;
+                }
+
+                libsais64_reconstruct_compacted_lms_suffixes_32s_1k(T, SA, n, k, m, fs, f);
+
+                if (buckets == NULL) { buckets = buffer = libsais64_ctx_buffer(ctx, k); }
+                if (buckets == NULL) { return -2; }
+            }
+            
+            libsais64_count_suffixes_32s(T, n, k, buckets);
+            libsais64_initialize_buckets_end_32s_1k(k, buckets);
+            libsais64_place_lms_suffixes_interval_32s_1k(T, SA, n, k, m, buckets);
+        }
+
+        libsais64_induce_final_order_32s_1k(T, SA, n, k, buckets);
+
+        return 0;
+    }
+}
+
+static sa_sint_t libsais64_main_8u(const unsigned char * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t bwt, sa_sint_t fs, LIBSAIS64_CONTEXT * RESTRICT ctx)
+{
+    sa_sint_t * RESTRICT buckets = ctx->buckets;
+
+    sa_sint_t m = libsais64_count_and_gather_lms_suffixes_8u(T, SA, n, buckets);
+
+    libsais64_initialize_buckets_start_and_end_8u(buckets);
+
+    if (m > 0)
+    {
+        sa_sint_t first_lms_suffix    = SA[n - m];
+        sa_sint_t left_suffixes_count = libsais64_initialize_buckets_for_lms_suffixes_radix_sort_8u(T, buckets, first_lms_suffix);
+
+        libsais64_radix_sort_lms_suffixes_8u(T, SA, n, m, buckets);
+        libsais64_initialize_buckets_for_partial_sorting_8u(T, buckets, first_lms_suffix, left_suffixes_count);
+        libsais64_induce_partial_order_8u(T, SA, n, buckets, first_lms_suffix, left_suffixes_count);
+
+        sa_sint_t names = libsais64_renumber_and_gather_lms_suffixes_8u(SA, n, m, fs);
+        if (names < m)
+        {
+            if (libsais64_main_32s(SA + n + fs - m, SA, m, names, fs + n - 2 * m, ctx) != 0)
+            {
+                return -2;
+            }
+
+            libsais64_gather_lms_suffixes_8u(T, SA, n);
+            libsais64_reconstruct_lms_suffixes(SA, n, m);
+        }
+
+        libsais64_place_lms_suffixes_interval_8u(SA, n, m, buckets);
+    }
+    else
+    {
+        memset(SA, 0, (size_t)n * sizeof(sa_sint_t));
+    }
+
+    return libsais64_induce_final_order_8u(T, SA, n, bwt, buckets);
+}
+
+static void libsais64_bwt_copy_8u(unsigned char * RESTRICT U, sa_sint_t * RESTRICT A, sa_sint_t n)
+{
+    const ptrdiff_t prefetch_distance = 32;
+
+    ptrdiff_t i, j;
+    for (i = 0, j = (ptrdiff_t)n - 7; i < j; i += 8)
+    {
+        libsais64_prefetch(&A[i + prefetch_distance]);
+
+        U[i + 0] = (unsigned char)A[i + 0];
+        U[i + 1] = (unsigned char)A[i + 1];
+        U[i + 2] = (unsigned char)A[i + 2];
+        U[i + 3] = (unsigned char)A[i + 3];
+        U[i + 4] = (unsigned char)A[i + 4];
+        U[i + 5] = (unsigned char)A[i + 5];
+        U[i + 6] = (unsigned char)A[i + 6];
+        U[i + 7] = (unsigned char)A[i + 7];
+    }
+
+    for (j += 7; i < j; i += 1)
+    {
+        U[i] = (unsigned char)A[i];
+    }
+}
+
+void * libsais64_create_ctx(void)
+{
+    return (void *)libsais64_create_ctx_main();
+}
+
+void libsais64_free_ctx(void * ctx)
+{
+    libsais64_free_ctx_main((LIBSAIS64_CONTEXT *)ctx);
+}
+
+sa_sint_t libsais64(const unsigned char * T, sa_sint_t * SA, sa_sint_t n)
+{
+    LIBSAIS64_CONTEXT * ctx = libsais64_create_ctx_main();
+    sa_sint_t index = ctx != NULL ? libsais64_ctx(ctx, T, SA, n, 0) : -2;
+
+    libsais64_free_ctx_main(ctx);
+    return index;
+}
+
+sa_sint_t libsais64_bwt(const unsigned char * T, unsigned char * U, sa_sint_t * A, sa_sint_t n)
+{
+    LIBSAIS64_CONTEXT * ctx = libsais64_create_ctx_main();
+    sa_sint_t index = ctx != NULL ? libsais64_bwt_ctx(ctx, T, U, A, n, 0) : -2;
+
+    libsais64_free_ctx_main(ctx);
+    return index;
+}
+
+sa_sint_t libsais64_ctx(void * ctx, const unsigned char * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t fs)
+{
+    if ((ctx == NULL) || (T == NULL) || (SA == NULL) || (n < 0) || (fs < 0))
+    {
+        return -1;
+    }
+    else if (n < 2)
+    {
+        if (n == 1) { SA[0] = 0; }
+        return 0;
+    }
+
+    return libsais64_main_8u(T, SA, n, 0, fs, (LIBSAIS64_CONTEXT *)ctx);
+}
+
+sa_sint_t libsais64_bwt_ctx(void * ctx, const unsigned char * T, unsigned char * U, sa_sint_t * A, sa_sint_t n, sa_sint_t fs)
+{
+    if ((ctx == NULL) || (T == NULL) || (U == NULL) || (A == NULL) || (n < 0) || (fs < 0)) 
+    { 
+        return -1; 
+    }
+    else if (n <= 1) 
+    { 
+        if (n == 1) { U[0] = T[0]; }
+        return n; 
+    }
+
+    sa_sint_t index = libsais64_main_8u(T, A, n, 1, fs, (LIBSAIS64_CONTEXT *)ctx);
+    if (index >= 0) 
+    { 
+        U[0] = T[n - 1];
+        libsais64_bwt_copy_8u(U + 1, A, index);
+        libsais64_bwt_copy_8u(U + 1 + index, A + 1 + index, n - index - 1);
+
+        index++;
+    }
+
+    return index;
+}
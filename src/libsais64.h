@@ -0,0 +1,92 @@
+/*--
+
+This file is a part of libsais, a library for linear time
+suffix array and burrows wheeler transform construction.
+
+   Copyright (c) 2021 Ilya Grebnov <ilya.grebnov@gmail.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+Please see the file LICENSE for full copyright information.
+
+--*/
+
+#ifndef LIBSAIS64_H
+#define LIBSAIS64_H 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+    * Constructs the suffix array of a given string.
+    * @param T [0..n-1] The input string.
+    * @param SA [0..n-1] The output array of suffixes.
+    * @param n The length of the given string.
+    * @return 0 if no error occurred, -1 or -2 otherwise.
+    */
+    int64_t libsais64(const unsigned char * T, int64_t * SA, int64_t n);
+
+    /**
+    * Constructs the burrows-wheeler transformed string of a given string.
+    * @param T [0..n-1] The input string.
+    * @param U [0..n-1] The output string. (can be T)
+    * @param A [0..n-1] The temporary array.
+    * @param n The length of the given string.
+    * @return The primary index if no error occurred, -1 or -2 otherwise.
+    */
+    int64_t libsais64_bwt(const unsigned char * T, unsigned char * U, int64_t * A, int64_t n);
+
+    /**
+    * Creates the libsais context that allows reusing allocated memory with each libsais operation.
+    * One context must not be used by several threads at the same time.
+    * @return The libsais context, NULL otherwise.
+    */
+    void * libsais64_create_ctx(void);
+
+    /**
+    * Destroys the libsais context and frees previously allocated memory.
+    * @param ctx The libsais context (can be NULL).
+    */
+    void libsais64_free_ctx(void * ctx);
+
+    /**
+    * Constructs the suffix array of a given string using libsais context.
+    * @param ctx The libsais context.
+    * @param T [0..n-1] The input string.
+    * @param SA [0..n-1+fs] The output array of suffixes.
+    * @param n The length of the given string.
+    * @param fs The extra space available at the end of SA array (can be 0).
+    * @return 0 if no error occurred, -1 or -2 otherwise.
+    */
+    int64_t libsais64_ctx(void * ctx, const unsigned char * T, int64_t * SA, int64_t n, int64_t fs);
+
+    /**
+    * Constructs the burrows-wheeler transformed string of a given string using libsais context.
+    * @param ctx The libsais context.
+    * @param T [0..n-1] The input string.
+    * @param U [0..n-1] The output string. (can be T)
+    * @param A [0..n-1+fs] The temporary array.
+    * @param n The length of the given string.
+    * @param fs The extra space available at the end of A array (can be 0).
+    * @return The primary index if no error occurred, -1 or -2 otherwise.
+    */
+    int64_t libsais64_bwt_ctx(void * ctx, const unsigned char * T, unsigned char * U, int64_t * A, int64_t n, int64_t fs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif